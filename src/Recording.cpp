@@ -1,7 +1,5 @@
 #include "Recording.hpp"
 
-const std::string Recording::RECORDING_FILE = "recording.xml";
-const std::string Recording::FRAMES_KEY = "frames";
-const std::string Recording::TIMESTAMPS_KEY = "timestamps";
+const std::string Recording::RECORDING_FILE = "recording.fbr";
 
 const TimePoint Recording::NO_FRAME_START = TimePoint::min();
\ No newline at end of file
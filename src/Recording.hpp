@@ -1,22 +1,22 @@
 #ifndef FLAPPYBIRD_RECORDING_HPP
 #define FLAPPYBIRD_RECORDING_HPP
 
+#include <atomic>
 #include <iostream>
-#include <opencv2/highgui.hpp>
+#include <memory>
 #include <opencv2/core/core.hpp>
 
 #include "display.hpp"
+#include "recordingFile.hpp"
+#include "recordingStream.hpp"
 #include "util.hpp"
 
 class Recording : public VideoSource {
-    const static std::string RECORDING_FILE;
-    const static std::string FRAMES_KEY;
-    const static std::string TIMESTAMPS_KEY;
     const static TimePoint NO_FRAME_START;
 
-    /// the only integral type OpenCV's serialization supports is int
-    using TimestampSerializationT = int;
 public:
+    const static std::string RECORDING_FILE;
+
     enum State {
         IDLE,
         PLAYBACK,
@@ -34,66 +34,29 @@ public:
 
         reset();
 
-        cv::FileStorage fs(RECORDING_FILE, cv::FileStorage::READ);
-
-        if (!fs.isOpened()) {
-            std::cerr << "Couldn't open file: " << RECORDING_FILE << std::endl;
+        try {
+            m_mapped = std::make_unique<MappedRecording>(RECORDING_FILE);
+        } catch (std::runtime_error& ex) {
+            std::cerr << ex.what() << std::endl;
             return false;
         }
 
-        cv::FileNode frames = fs[FRAMES_KEY];
-        if (frames.type() != cv::FileNode::SEQ)
-        {
-            std::cerr << "Frames not a cv::FileNode::SEQ" << std::endl;
+        if (m_mapped->frameCount() < 2) {
+            std::cerr << "Recording must have at least two frames (found " << m_mapped->frameCount() << ")" << std::endl;
+            m_mapped.reset();
             return false;
         }
 
-        if (frames.size() < 2) {
-            std::cerr << "Recording must have at least two frames (found " << frames.size() << ")" << std::endl;
-            return false;
-        }
-
-        const TimePoint::duration placeholder{};
-        cv::FileNodeIterator framesEnd = frames.end();
-        for (cv::FileNodeIterator it = frames.begin(); it != framesEnd; ++it)
-        {
-            cv::Mat temp;
-            *it >> temp;
-            m_frames.push_back(std::make_pair(placeholder, std::move(temp)));
-        }
-
-        cv::FileNode timestamps = fs[TIMESTAMPS_KEY];
-        if (timestamps.type() != cv::FileNode::SEQ)
-        {
-            std::cerr << "Timestamps not a cv::FileNode::SEQ" << std::endl;
-            return false;
-        }
-
-        if (timestamps.size() < 2) {
-            std::cerr << "Recording must have at least two timestamps (found " << timestamps.size() << ")" << std::endl;
-            return false;
-        }
-
-        if (timestamps.size() != frames.size()) {
-            std::cerr << "Recording must have equal number of frames and timestamps. Found " << frames.size()
-                      << " frames and " << timestamps.size() << " timestamps." << std::endl;
-            return false;
-        }
-
-        cv::FileNodeIterator timestampsEnd = timestamps.end();
-        cv::FileNodeIterator timestampsBegin = timestamps.begin();
-        for (cv::FileNodeIterator it = timestampsBegin; it != timestampsEnd; ++it)
-        {
-            TimestampSerializationT timestamp;
-            *it >> timestamp;
-            m_frames[it - timestampsBegin].first = TimePoint::duration{timestamp};
+        // the frames point into the mapping, they're only read from disk once played
+        m_frames.reserve(m_mapped->frameCount());
+        for (size_t i = 0; i < m_mapped->frameCount(); ++i) {
+            m_frames.emplace_back(m_mapped->timestamp(i), m_mapped->frame(i));
         }
 
         // scene boundaries are loaded as they were at the time of recording
-        display.deserialise(fs);
+        display.setViewport(m_mapped->viewport());
 
-        cv::namedWindow("Playback speed");
-        cv::createTrackbar("Speed", "Playback speed", &m_playbackSpeed, 100);
+        m_playbackSpeed = display.addTrackbar("Playback speed", "Speed", 100, 100);
 
         m_state = PLAYBACK;
 
@@ -101,36 +64,36 @@ public:
         return true;
     }
 
-    void save(const VideoFeed& display) {
+    /// Finishes writing the recording started with startRecording().
+    void save() {
         assert(m_state == RECORDING);
         std::cout << "Saving feed to: " << RECORDING_FILE << std::endl;
 
-        if (m_frames.size() < 2) {
-            std::cerr << "Cannot save recording, it must have at least two frames (this one has " << m_frames.size() << ")" << std::endl;
-            return;
-        }
-        cv::FileStorage fs(RECORDING_FILE, cv::FileStorage::WRITE);
-
-        // scene boundaries are also saved so we don't have to manually select them at load time
-        display.serialise(fs);
-
-        fs << "frames" << "[";
-        for (const auto& frame : m_frames) {
-            fs << frame.second;
+        try {
+            m_stream->finish();
+            std::cout << "Saved " << m_stream->writtenFrames() << " frames, dropped " << m_stream->droppedFrames()
+                      << std::endl;
+            if (m_stream->writtenFrames() < 2) {
+                std::cerr << "The recording won't load, it must have at least two frames" << std::endl;
+            }
+        } catch (std::runtime_error& ex) {
+            std::cerr << "Saving the recording failed: " << ex.what() << std::endl;
         }
-        fs << "]";
-
-        fs << "timestamps" << "[";
-        for (const auto& frame : m_frames) {
-            assert(frame.first.count() < std::numeric_limits<TimestampSerializationT>::max());
-            fs << static_cast<TimestampSerializationT>(frame.first.count());
-        }
-        fs << "]";
 
         reset();
     }
 
-    void startRecording() {
+    /// Frames are streamed to disk as they're recorded, so this can run for as long as there's disk space.
+    void startRecording(const VideoFeed& display) {
+        assert(m_state == IDLE);
+        try {
+            // scene boundaries are also saved so we don't have to manually select them at load time
+            m_stream = std::make_unique<RecordingStream>(RECORDING_FILE, display.viewport());
+        } catch (std::runtime_error& ex) {
+            std::cerr << "Can't record: " << ex.what() << std::endl;
+            return;
+        }
+
         // TODO this should be a separate member (separate for recording, separate for playback). Do we need a separate
         // type for each? Note this isn't updated when recording frames, so it's really "start of recording", not of
         // current frame.
@@ -138,10 +101,15 @@ public:
         m_state = RECORDING;
     }
 
-    void record(const cv::Mat& frame) {
+    /// Records the display's current frame, without copying it if it's in a pooled buffer.
+    void record(const VideoFeed& display) {
         assert(m_state == RECORDING);
-        m_frames.emplace_back(toTime(std::chrono::system_clock::now()) - m_currentFrameStart,
-                              frame.clone());
+        const TimePoint::duration timestamp = toTime(std::chrono::system_clock::now()) - m_currentFrameStart;
+        if (display.getCurrentPooledFrame()) {
+            m_stream->push(timestamp, display.getCurrentPooledFrame());
+        } else {
+            m_stream->push(timestamp, display.getCurrentFrame());
+        }
     }
 
     // Recording captures a frame by advancing the tape if next frame is due
@@ -161,7 +129,7 @@ public:
         // by a float, we obtain a std::chrono::duration<float> (as long as type is auto). If m_playbackSpeed is 0,
         // betweenFrameDelta.count() is inf and everything behaves as expected (we get a pause).
         auto betweenFrameDelta = (m_frames[m_currentPlaybackFrame + 1].first - m_frames[m_currentPlaybackFrame].first)
-                                 * (100.f / m_playbackSpeed);
+                                 * (100.f / m_playbackSpeed->load());
 
         if (currentFrameElapsed > betweenFrameDelta) {
             // last frame isn't displayed (we don't know its duration) - it's only used to determine
@@ -181,7 +149,8 @@ public:
 
     void reset() {
         m_state = IDLE;
-        m_frames.clear();
+        m_frames.clear(); // before the mapping they point into
+        m_mapped.reset();
         m_currentFrameStart = NO_FRAME_START;
         m_currentPlaybackFrame = 0;
     }
@@ -189,10 +158,12 @@ public:
 public:
     // time is from the start of the recording
     std::vector<std::pair<TimePoint::duration, cv::Mat>> m_frames;
+    std::unique_ptr<MappedRecording> m_mapped; // backs m_frames during playback
+    std::unique_ptr<RecordingStream> m_stream; // while recording
     TimePoint m_currentFrameStart = NO_FRAME_START;
     size_t m_currentPlaybackFrame = 0;
     State m_state = State::IDLE;
-    int m_playbackSpeed = 100; // percent
+    std::shared_ptr<const std::atomic<int>> m_playbackSpeed; // percent, set by load()
     bool m_loaded = false;
 };
 
@@ -0,0 +1,34 @@
+#ifndef FLAPPYBIRD_REPLAY_SOURCE_HPP
+#define FLAPPYBIRD_REPLAY_SOURCE_HPP
+
+#include "constants.hpp"
+#include "recordingFile.hpp"
+#include "VideoSource.hpp"
+
+/**
+ * Plays back a recording one frame per seek(), with no regard for the recording's timing - unlike Recording, which
+ * paces playback by the wall clock. For running the pipeline offline as fast as it'll go.
+ */
+class ReplaySource : public VideoSource {
+public:
+    explicit ReplaySource(const MappedRecording& recording) : m_recording(recording) {}
+
+    /// The frame captureFrame() returns from now on.
+    void seek(size_t frame) {
+        m_currentFrame = m_recording.frame(frame);
+    }
+
+    const cv::Mat& captureFrame() override {
+        return m_currentFrame;
+    }
+
+    double capturePoint() const override {
+        return CAPTURE_POINT;
+    }
+
+private:
+    const MappedRecording& m_recording;
+    cv::Mat m_currentFrame;
+};
+
+#endif //FLAPPYBIRD_REPLAY_SOURCE_HPP
@@ -8,6 +8,14 @@
 #include <X11/Xutil.h>
 #include <vector>
 
+// viewport into the Android emulator, screen coordinates can be found using:
+// cnee --record --mouse | awk  '/7,4,0,0,1/ { system("xdotool getmouselocation") }'
+// remember to set viewport boundaries into that viewport (like we would with a webcam, see display.cpp)
+static constexpr int EMULATOR_LEFT_X = 565;
+static constexpr int EMULATOR_RIGHT_X = 1419;
+static constexpr int EMULATOR_TOP_Y = 745;
+static constexpr int EMULATOR_BOTTOM_Y = 1708;
+
 class ScreenCapture : public VideoSource {
 
 public:
@@ -17,16 +25,9 @@ public:
 
         Window root = DefaultRootWindow(m_x11display);
 
-        // viewport into the Android emulator, screen coordinates can be found using:
-        // cnee --record --mouse | awk  '/7,4,0,0,1/ { system("xdotool getmouselocation") }'
-        // remember to set viewport boundaries into that viewport (like we would with a webcam, see display.cpp)
-        const int leftX = 565;
-        const int rightX = 1419;
-        const int topY = 745;
-        const int bottomY = 1708;
-        const int width = rightX - leftX;
-        const int height = bottomY - topY;
-        XImage* img = XGetImage(m_x11display, root, leftX, topY, width, height, AllPlanes, ZPixmap);
+        const int width = EMULATOR_RIGHT_X - EMULATOR_LEFT_X;
+        const int height = EMULATOR_BOTTOM_Y - EMULATOR_TOP_Y;
+        XImage* img = XGetImage(m_x11display, root, EMULATOR_LEFT_X, EMULATOR_TOP_Y, width, height, AllPlanes, ZPixmap);
         const int bitsPerPixel = img->bits_per_pixel;
 
         m_pixelBuffer.resize(width * height * 4);
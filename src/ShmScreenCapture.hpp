@@ -0,0 +1,113 @@
+#ifndef FLAPPYBIRD_SHM_SCREEN_CAPTURE_HPP
+#define FLAPPYBIRD_SHM_SCREEN_CAPTURE_HPP
+
+#include "constants.hpp"
+#include "ScreenCapture.hpp"
+#include "VideoSource.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <stdexcept>
+
+/**
+ * Same as ScreenCapture but using the MIT-SHM extension: the X server writes the viewport straight into a shared
+ * memory segment attached once up front, instead of serialising it over the socket into a freshly allocated XImage
+ * every frame. The returned cv::Mat wraps the segment, so there's no per-frame allocation or copy either - which also
+ * means the frame is overwritten by the next captureFrame().
+ *
+ * Only works with a local X server (or Xvfb), the constructor throws if the extension isn't usable.
+ */
+class ShmScreenCapture : public VideoSource {
+public:
+    ShmScreenCapture(Display* const x11display) : m_x11display(x11display) {
+        if (!XShmQueryExtension(m_x11display)) {
+            throw std::runtime_error{"MIT-SHM extension not available"};
+        }
+
+        const int screen = DefaultScreen(m_x11display);
+        const int width = EMULATOR_RIGHT_X - EMULATOR_LEFT_X;
+        const int height = EMULATOR_BOTTOM_Y - EMULATOR_TOP_Y;
+        m_image = XShmCreateImage(m_x11display, DefaultVisual(m_x11display, screen), DefaultDepth(m_x11display, screen),
+                                  ZPixmap, nullptr, &m_segment, width, height);
+        if (!m_image) {
+            throw std::runtime_error{"XShmCreateImage failed"};
+        }
+
+        m_segment.shmid = shmget(IPC_PRIVATE, m_image->bytes_per_line * m_image->height, IPC_CREAT | 0600);
+        if (m_segment.shmid < 0) {
+            XDestroyImage(m_image);
+            throw std::runtime_error{"shmget failed"};
+        }
+
+        void* const address = shmat(m_segment.shmid, nullptr, 0);
+        if (address == reinterpret_cast<void*>(-1)) {
+            shmctl(m_segment.shmid, IPC_RMID, nullptr);
+            XDestroyImage(m_image);
+            throw std::runtime_error{"shmat failed"};
+        }
+        m_segment.shmaddr = m_image->data = static_cast<char*>(address);
+        m_segment.readOnly = False;
+
+        // Attach failures (e.g. a remote server) are reported asynchronously through the error handler, which exits
+        // by default - swap in one that just takes note and sync so we find out here.
+        s_attachFailed = false;
+        XSync(m_x11display, False);
+        XErrorHandler previousHandler = XSetErrorHandler(attachErrorHandler);
+        const Status attached = XShmAttach(m_x11display, &m_segment);
+        XSync(m_x11display, False);
+        XSetErrorHandler(previousHandler);
+
+        // Mark the segment for removal right away, it stays alive while attached but won't leak if we crash.
+        shmctl(m_segment.shmid, IPC_RMID, nullptr);
+
+        if (!attached || s_attachFailed) {
+            shmdt(m_segment.shmaddr);
+            m_image->data = nullptr;
+            XDestroyImage(m_image);
+            throw std::runtime_error{"XShmAttach failed"};
+        }
+
+        m_currentFrame = cv::Mat(height, width, m_image->bits_per_pixel > 24 ? CV_8UC4 : CV_8UC3, m_image->data,
+                                 m_image->bytes_per_line);
+    }
+
+    ~ShmScreenCapture() {
+        XShmDetach(m_x11display, &m_segment);
+        XSync(m_x11display, False);
+        shmdt(m_segment.shmaddr);
+        m_image->data = nullptr; // not ours to free
+        XDestroyImage(m_image);
+    }
+
+    ShmScreenCapture(const ShmScreenCapture&) = delete;
+    ShmScreenCapture& operator=(const ShmScreenCapture&) = delete;
+
+    const cv::Mat& captureFrame() override {
+        XShmGetImage(m_x11display, DefaultRootWindow(m_x11display), m_image, EMULATOR_LEFT_X, EMULATOR_TOP_Y,
+                     AllPlanes);
+        return m_currentFrame;
+    }
+
+    double capturePoint() const override {
+        return CAPTURE_POINT;
+    }
+
+private:
+    static int attachErrorHandler(Display*, XErrorEvent*) {
+        s_attachFailed = true;
+        return 0;
+    }
+
+    static inline bool s_attachFailed = false;
+
+    Display* const m_x11display;
+    XShmSegmentInfo m_segment{};
+    XImage* m_image{nullptr};
+    cv::Mat m_currentFrame;
+};
+
+#endif //FLAPPYBIRD_SHM_SCREEN_CAPTURE_HPP
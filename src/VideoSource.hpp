@@ -2,6 +2,8 @@
 
 class VideoSource {
 public:
+    virtual ~VideoSource() = default;
+
     virtual const cv::Mat& captureFrame() = 0;
     // the point during captureFrame() at which the actual state of the underlying image is captured
     // (accounting for memory transfer etc.)
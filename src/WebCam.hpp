@@ -12,12 +12,11 @@ public:
             throw std::logic_error{"Cannot capture video: VideoCapture not open"};
         }
 
-        cv::Mat temp;
-        if (!m_cap.read(temp)) { // read a new frame from camera
+        if (!m_cap.read(m_capturedFrame)) { // read a new frame from camera
             throw std::runtime_error{"Cannot read a frame from video stream"};
         }
 
-        cv::flip(temp, m_currentFrame, -1);
+        cv::flip(m_capturedFrame, m_currentFrame, -1);
 
         return m_currentFrame;
     }
@@ -28,6 +27,7 @@ public:
 
 private:
     cv::VideoCapture m_cap{-1};
+    cv::Mat m_capturedFrame; // kept so read() can reuse its buffer
     cv::Mat m_currentFrame;
 };
 
@@ -0,0 +1,9 @@
+#pragma once
+
+/// What the planners decide to do with the bird at a given point.
+enum class Action {
+    TAP,
+    NO_TAP,
+    ANY,
+    NONE
+};
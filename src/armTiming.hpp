@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+
+#include "arm.hpp"
+#include "constants.hpp"
+#include "trajectory.hpp"
+
+/*
+ * Arm timing as seen by the Driver's search, which needs the tap and lift delays at every node. With a StaticArmTiming
+ * they're compile time constants, the trajectory table is known to be there and the branches on all of them fold
+ * away. RuntimeArmTiming asks the arm itself, for arms whose delays are only known (e.g. calibrated) at run time.
+ *
+ * A policy provides tapDelay(), liftDelay() and trajectory() (the precomputed trajectory for the tap delay, or null).
+ */
+
+template<long TapDelayMs, long LiftDelayMs>
+struct StaticArmTiming {
+    static constexpr std::chrono::milliseconds tapDelay() {
+        return std::chrono::milliseconds{TapDelayMs};
+    }
+
+    static constexpr std::chrono::milliseconds liftDelay() {
+        return std::chrono::milliseconds{LiftDelayMs};
+    }
+
+    static constexpr const trajectory::Table* trajectory() {
+        return trajectory::forTapDelay(tapDelay());
+    }
+
+    static bool matches(const Arm& arm) {
+        return arm.tapDelay() == tapDelay() && arm.liftDelay() == liftDelay();
+    }
+
+private:
+    static_assert(trajectory::forTapDelay(std::chrono::milliseconds{TapDelayMs}) != nullptr,
+                  "static timing is only for arms with a precomputed trajectory in trajectory.hpp");
+};
+
+using PhysicalArmTiming = StaticArmTiming<PHYSICAL_ARM_TAP_DELAY.count(), PHYSICAL_ARM_LIFT_DELAY.count()>;
+using SimulatedArmTiming = StaticArmTiming<SIMULATED_ARM_TAP_DELAY.count(), SIMULATED_ARM_LIFT_DELAY.count()>;
+
+class RuntimeArmTiming {
+public:
+    explicit RuntimeArmTiming(const Arm& arm) : m_arm{arm}, m_trajectory{trajectory::forTapDelay(arm.tapDelay())} {}
+
+    std::chrono::milliseconds tapDelay() const {
+        return m_arm.tapDelay();
+    }
+
+    std::chrono::milliseconds liftDelay() const {
+        return m_arm.liftDelay();
+    }
+
+    const trajectory::Table* trajectory() const {
+        return m_trajectory;
+    }
+
+private:
+    const Arm& m_arm;
+    const trajectory::Table* const m_trajectory;
+};
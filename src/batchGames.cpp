@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulatedGame.hpp"
+#include "threadPool.hpp"
+#include "toolOptions.hpp"
+
+/*
+ * Plays lots of simulated games (see playSimulatedGame()) on all cores and reports scores, what the bird crashed into
+ * and the latency distributions over all of them - for judging a change to the planner or the constants without
+ * sitting through live games.
+ *
+ * --engine and --budget-us take comma separated lists, every combination is played over the same seeds so that the
+ * configurations can be compared game for game. "none" is an unlimited budget.
+ *
+ * usage: batchGames [--games N] [--first-seed N] [--threads N] [--engine recursive,batch,...]
+ *                   [--budget-us none,500,...] [--detection full|lazy|pyramid] [--frame-ms N] [--time-limit-s N]
+ *                   [--tracking] [--swept] [--quantum-ms N] [--adaptive] [--warm-start] [--policy table.policy]
+ *                   [--ground-truth]
+ */
+
+struct Options {
+    size_t games{1000};
+    unsigned firstSeed{0};
+    unsigned threads{std::thread::hardware_concurrency()};
+    std::vector<Driver::PlannerEngine> engines{Driver::PlannerEngine::RECURSIVE};
+    std::vector<std::optional<std::chrono::microseconds>> budgets{std::nullopt};
+    GameSettings settings; // everything but the engine and the budget
+};
+
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "--games") {
+            options.games = std::stoul(optionValue(argc, argv, i));
+        } else if (arg == "--first-seed") {
+            options.firstSeed = static_cast<unsigned>(std::stoul(optionValue(argc, argv, i)));
+        } else if (arg == "--threads") {
+            options.threads = static_cast<unsigned>(std::stoul(optionValue(argc, argv, i)));
+        } else if (arg == "--engine") {
+            options.engines.clear();
+            for (const std::string& engine : splitList(optionValue(argc, argv, i))) {
+                options.engines.push_back(parsePlannerEngine(engine));
+            }
+        } else if (arg == "--budget-us") {
+            options.budgets.clear();
+            for (const std::string& budget : splitList(optionValue(argc, argv, i))) {
+                if (budget == "none") {
+                    options.budgets.emplace_back();
+                } else {
+                    options.budgets.emplace_back(std::chrono::microseconds{std::stol(budget)});
+                }
+            }
+        } else if (arg == "--detection") {
+            options.settings.detection = parseDetectionMode(optionValue(argc, argv, i));
+        } else if (arg == "--frame-ms") {
+            options.settings.frameInterval = TimePoint::duration{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--time-limit-s") {
+            options.settings.timeLimit = std::chrono::seconds{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--tracking") {
+            options.settings.tracking = true;
+        } else if (arg == "--swept") {
+            options.settings.sweptCollision = true;
+        } else if (arg == "--quantum-ms") {
+            options.settings.searchQuantum = TimePoint::duration{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--adaptive") {
+            options.settings.adaptiveStep = true;
+        } else if (arg == "--warm-start") {
+            options.settings.warmStart = true;
+        } else if (arg == "--policy") {
+            options.settings.policy = std::make_shared<const PolicyTable>(optionValue(argc, argv, i));
+        } else if (arg == "--ground-truth") {
+            options.settings.groundTruth = true;
+        } else {
+            throw std::invalid_argument("unknown option: " + arg);
+        }
+    }
+
+    if (options.engines.empty() || options.budgets.empty() || options.games == 0 || options.threads == 0) {
+        throw std::invalid_argument("nothing to play");
+    }
+    // checked here rather than by each game, on a pool thread
+    if (options.settings.frameInterval <= VIRTUAL_PROCESSING_DELAY) {
+        throw std::invalid_argument("--frame-ms must be more than the processing delay");
+    }
+    if (options.settings.searchQuantum <= SIMULATED_ARM_TAP_DELAY) {
+        throw std::invalid_argument("--quantum-ms must be more than the arm's tap delay");
+    }
+    checkPolicy(options.settings);
+    return options;
+}
+
+static const char* describe(Driver::PlannerEngine engine) {
+    switch (engine) {
+        case Driver::PlannerEngine::RECURSIVE:
+            return "recursive";
+        case Driver::PlannerEngine::BATCH:
+            return "batch";
+        case Driver::PlannerEngine::PARALLEL:
+            return "parallel";
+    }
+    return "?";
+}
+
+/// Everything played with one configuration, added to by whichever thread finishes a game.
+struct Aggregate {
+    GameSettings settings;
+
+    std::mutex mutex;
+    std::vector<int> scores;
+    size_t crashes[3]{}; // by GameSimulator::Crash
+    size_t taps{0};
+    TimePoint::duration played{0};
+    Driver::SearchTotals search;
+    LatencyStats detect{"detect"};
+    LatencyStats plan{"plan"};
+    LatencyStats frame{"frame"};
+
+    void add(const GameResult& result) {
+        std::unique_lock<std::mutex> _(mutex);
+        scores.push_back(result.score);
+        ++crashes[static_cast<int>(result.crash)];
+        taps += result.taps;
+        played += result.played;
+        search.decisions += result.search.decisions;
+        search.nodes += result.search.nodes;
+        search.plansReused += result.search.plansReused;
+        detect.merge(result.detect);
+        plan.merge(result.plan);
+        frame.merge(result.frame);
+    }
+
+    void report(std::ostream& out) {
+        std::sort(scores.begin(), scores.end());
+        double total = 0;
+        for (int score : scores) {
+            total += score;
+        }
+
+        out << std::fixed << std::setprecision(1) << "engine " << describe(settings.engine) << ", budget ";
+        if (settings.budget) {
+            out << settings.budget->count() << "us";
+        } else {
+            out << "none";
+        }
+        out << ": " << scores.size() << " games, score mean " << total / scores.size() << " median "
+            << scores[scores.size() / 2] << " min " << scores.front() << " max " << scores.back() << "\n"
+            << "crashed into: pipe " << crashes[static_cast<int>(GameSimulator::Crash::PIPE)] << ", ground "
+            << crashes[static_cast<int>(GameSimulator::Crash::GROUND)] << ", reached the time limit "
+            << crashes[static_cast<int>(GameSimulator::Crash::NONE)] << "; "
+            << static_cast<double>(taps) / scores.size() << " taps per game, "
+            << std::chrono::duration<double>(played).count() << "s played, "
+            << static_cast<double>(search.nodes) / std::max<size_t>(search.decisions, 1) << " nodes per decision, "
+            << 100.0 * search.plansReused / std::max<size_t>(search.decisions, 1) << "% of them plans reused\n";
+        LatencyStats::reportHeader(out);
+        for (LatencyStats* stats : {&detect, &plan, &frame}) {
+            stats->report(out);
+        }
+        out << "\n";
+    }
+};
+
+int main(int argc, char** argv) {
+    try {
+        const Options options = parseOptions(argc, argv);
+        if (options.threads > 1
+                && std::find(options.engines.begin(), options.engines.end(), Driver::PlannerEngine::PARALLEL)
+                   != options.engines.end()) {
+            std::cerr << "The parallel engine starts its own threads per game, consider --threads 1" << std::endl;
+        }
+
+        std::vector<std::unique_ptr<Aggregate>> aggregates;
+        for (Driver::PlannerEngine engine : options.engines) {
+            for (const std::optional<std::chrono::microseconds>& budget : options.budgets) {
+                aggregates.push_back(std::make_unique<Aggregate>());
+                aggregates.back()->settings = options.settings;
+                aggregates.back()->settings.engine = engine;
+                aggregates.back()->settings.budget = budget;
+            }
+        }
+
+        // each game creates (and owns) its own simulator, detector and driver, nothing is shared between them
+        ThreadPool pool(options.threads);
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pool.parallelFor(aggregates.size() * options.games, [&](size_t i) {
+            Aggregate& aggregate = *aggregates[i / options.games];
+            const unsigned seed = options.firstSeed + static_cast<unsigned>(i % options.games);
+            aggregate.add(playSimulatedGame(seed, aggregate.settings));
+        });
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        for (const std::unique_ptr<Aggregate>& aggregate : aggregates) {
+            aggregate->report(std::cout);
+        }
+        std::cout << aggregates.size() * options.games << " games in " << elapsed.count() << "s on "
+                  << pool.threadCount() << " threads" << std::endl;
+    } catch (std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
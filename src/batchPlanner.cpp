@@ -0,0 +1,351 @@
+#include "batchPlanner.hpp"
+
+#include "constants.hpp"
+#include "trajectory.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_PLANNER_HAS_AVX2_KERNELS
+#endif
+
+namespace {
+
+constexpr float CRASHED = -1.f;
+
+/// Everything the bird can hit, flattened for the kernels.
+struct Obstacles {
+    int gapCount;
+    float left[2];
+    float right[2];
+    float upper[2];
+    float lower[2];
+    float ground; // bird centre below this is a crash (accounts for radius and buffer)
+};
+
+Obstacles makeObstacles(const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps, Coordinate groundLevel) {
+    Obstacles obstacles{};
+    for (const std::optional<Gap>* gap : {&gaps.first, &gaps.second}) {
+        if (!gap->has_value()) {
+            break;
+        }
+        obstacles.left[obstacles.gapCount] = (*gap)->lowerLeft.x.val;
+        obstacles.right[obstacles.gapCount] = (*gap)->lowerRight.x.val;
+        obstacles.upper[obstacles.gapCount] = (*gap)->upperLeft.y.val;
+        obstacles.lower[obstacles.gapCount] = (*gap)->lowerLeft.y.val;
+        ++obstacles.gapCount;
+    }
+    obstacles.ground = (groundLevel - BIRD_RADIUS - GROUND_SAFETY_BUFFER).val;
+    return obstacles;
+}
+
+// Scalar equivalents of Driver::minClearance() and Driver::predictMotion(), used for the tail of a level and on CPUs
+// without AVX2. The nearest corner is found with min(dx^2) + min(dy^2) - the same as the smallest of the four
+// distances, with a single sqrt.
+void clearanceScalar(const float* x, const float* y, float* clearance, size_t begin, size_t end,
+                     const Obstacles& obstacles) {
+    for (size_t i = begin; i < end; ++i) {
+        if (y[i] > obstacles.ground) {
+            clearance[i] = CRASHED;
+            continue;
+        }
+
+        float best = std::numeric_limits<float>::max();
+        for (int g = 0; g < obstacles.gapCount; ++g) {
+            float gapClearance;
+            if (x[i] > obstacles.left[g] && x[i] < obstacles.right[g]) {
+                gapClearance = std::min((y[i] - BIRD_RADIUS.val) - obstacles.upper[g],
+                                        obstacles.lower[g] - (y[i] + BIRD_RADIUS.val));
+            } else {
+                const float dx = std::min(std::abs(x[i] - obstacles.left[g]), std::abs(x[i] - obstacles.right[g]));
+                const float dy = std::min(std::abs(y[i] - obstacles.upper[g]), std::abs(y[i] - obstacles.lower[g]));
+                gapClearance = std::sqrt(dx * dx + dy * dy) - BIRD_RADIUS.val;
+            }
+            best = std::min(best, gapClearance);
+        }
+
+        clearance[i] = best < SAFETY_BUFFER.val ? CRASHED : best;
+    }
+}
+
+void stepScalar(const float* speed, float* displacement, float* speedOut, size_t begin, size_t end, long deltaT) {
+    for (size_t i = begin; i < end; ++i) {
+        const trajectory::VerticalStep step = trajectory::verticalStep(speed[i], deltaT);
+        displacement[i] = step.displacement;
+        if (speedOut) {
+            speedOut[i] = step.speed;
+        }
+    }
+}
+
+#ifdef BATCH_PLANNER_HAS_AVX2_KERNELS
+__attribute__((target("avx2,fma")))
+void clearanceAvx2(const float* x, const float* y, float* clearance, size_t n, const Obstacles& obstacles) {
+    const __m256 radius = _mm256_set1_ps(BIRD_RADIUS.val);
+    const __m256 ground = _mm256_set1_ps(obstacles.ground);
+    const __m256 safetyBuffer = _mm256_set1_ps(SAFETY_BUFFER.val);
+    const __m256 crashedValue = _mm256_set1_ps(CRASHED);
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 vx = _mm256_loadu_ps(x + i);
+        const __m256 vy = _mm256_loadu_ps(y + i);
+
+        __m256 crashed = _mm256_cmp_ps(vy, ground, _CMP_GT_OQ);
+        __m256 best = _mm256_set1_ps(std::numeric_limits<float>::max());
+        for (int g = 0; g < obstacles.gapCount; ++g) {
+            const __m256 left = _mm256_set1_ps(obstacles.left[g]);
+            const __m256 right = _mm256_set1_ps(obstacles.right[g]);
+            const __m256 upper = _mm256_set1_ps(obstacles.upper[g]);
+            const __m256 lower = _mm256_set1_ps(obstacles.lower[g]);
+
+            const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(vx, left, _CMP_GT_OQ),
+                                                _mm256_cmp_ps(vx, right, _CMP_LT_OQ));
+            const __m256 insideClearance = _mm256_min_ps(_mm256_sub_ps(_mm256_sub_ps(vy, radius), upper),
+                                                         _mm256_sub_ps(lower, _mm256_add_ps(vy, radius)));
+
+            const __m256 dx = _mm256_min_ps(_mm256_andnot_ps(signMask, _mm256_sub_ps(vx, left)),
+                                            _mm256_andnot_ps(signMask, _mm256_sub_ps(vx, right)));
+            const __m256 dy = _mm256_min_ps(_mm256_andnot_ps(signMask, _mm256_sub_ps(vy, upper)),
+                                            _mm256_andnot_ps(signMask, _mm256_sub_ps(vy, lower)));
+            const __m256 cornerClearance = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy))),
+                                                         radius);
+
+            best = _mm256_min_ps(best, _mm256_blendv_ps(cornerClearance, insideClearance, inside));
+        }
+
+        crashed = _mm256_or_ps(crashed, _mm256_cmp_ps(best, safetyBuffer, _CMP_LT_OQ));
+        _mm256_storeu_ps(clearance + i, _mm256_blendv_ps(best, crashedValue, crashed));
+    }
+
+    clearanceScalar(x, y, clearance, i, n, obstacles);
+}
+
+__attribute__((target("avx2,fma")))
+void stepAvx2(const float* speed, float* displacement, float* speedOut, size_t n, long deltaT) {
+    const __m256 gravity = _mm256_set1_ps(GRAVITY.speed.val.val);
+    const __m256 terminalVelocity = _mm256_set1_ps(TERMINAL_VELOCITY.val.val);
+    const __m256 dt = _mm256_set1_ps(static_cast<float>(deltaT));
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_loadu_ps(speed + i);
+        const __m256 projected = _mm256_fmadd_ps(gravity, dt, v);
+        const __m256 overTerminal = _mm256_cmp_ps(projected, terminalVelocity, _CMP_GT_OQ);
+
+        const __m256 freeDisplacement = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(v, projected), half), dt);
+
+        // see Driver::predictMotion() - the terminal velocity period is truncated to whole milliseconds
+        const __m256 tvPeriod = _mm256_round_ps(_mm256_div_ps(_mm256_sub_ps(projected, terminalVelocity), gravity),
+                                                _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        const __m256 accelerating = _mm256_sub_ps(dt, tvPeriod);
+        const __m256 averageUnderAcceleration = _mm256_mul_ps(_mm256_add_ps(v, _mm256_fmadd_ps(gravity, accelerating, v)),
+                                                              half);
+        const __m256 averageSpeed = _mm256_add_ps(_mm256_mul_ps(averageUnderAcceleration, _mm256_div_ps(accelerating, dt)),
+                                                  _mm256_mul_ps(terminalVelocity, _mm256_div_ps(tvPeriod, dt)));
+        const __m256 terminalDisplacement = _mm256_mul_ps(averageSpeed, dt);
+
+        _mm256_storeu_ps(displacement + i, _mm256_blendv_ps(freeDisplacement, terminalDisplacement, overTerminal));
+        if (speedOut) {
+            _mm256_storeu_ps(speedOut + i, _mm256_blendv_ps(projected, terminalVelocity, overTerminal));
+        }
+    }
+
+    stepScalar(speed, displacement, speedOut, i, n, deltaT);
+}
+
+const bool HAS_AVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif // BATCH_PLANNER_HAS_AVX2_KERNELS
+
+/// Clearance of every node, CRASHED (negative) if it hit something.
+void clearance(const float* x, const float* y, float* clearance, size_t n, const Obstacles& obstacles) {
+#ifdef BATCH_PLANNER_HAS_AVX2_KERNELS
+    if (HAS_AVX2) {
+        clearanceAvx2(x, y, clearance, n, obstacles);
+        return;
+    }
+#endif
+    clearanceScalar(x, y, clearance, 0, n, obstacles);
+}
+
+/// Vertical displacement (and, if `speedOut` isn't null, speed) of every node after `deltaT` without a tap.
+void step(const float* speed, float* displacement, float* speedOut, size_t n, long deltaT) {
+#ifdef BATCH_PLANNER_HAS_AVX2_KERNELS
+    if (HAS_AVX2) {
+        stepAvx2(speed, displacement, speedOut, n, deltaT);
+        return;
+    }
+#endif
+    stepScalar(speed, displacement, speedOut, 0, n, deltaT);
+}
+
+} // namespace
+
+BatchPlanner::BatchPlanner(std::chrono::milliseconds tapDelay, std::chrono::milliseconds liftDelay,
+                           Coordinate groundLevel)
+        : m_tapDelay{tapDelay}, m_liftDelay{liftDelay}, m_groundLevel{groundLevel} {
+    assert(SIMULATION_TIME_QUANTUM > m_tapDelay);
+}
+
+void BatchPlanner::merge(Level& into, float x, float y, float verticalSpeed, int32_t sinceLastTap, float nearestMiss,
+                         bool tapped) {
+    // once the arm is ready to tap again, it stays ready until we tap (same as Driver::searchKey())
+    sinceLastTap = std::min(sinceLastTap, static_cast<int32_t>(m_liftDelay.count()) + 1);
+
+    const auto yKey = static_cast<int32_t>(std::lround(y / TRANSPOSITION_POSITION_QUANTUM.val));
+    const auto speedKey = static_cast<int32_t>(std::lround(verticalSpeed / TRANSPOSITION_SPEED_QUANTUM.val.val));
+    // x isn't part of the key, all nodes on a level are (up to rounding) at the same x
+    const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(yKey)) << 32)
+                         | (static_cast<uint64_t>(static_cast<uint32_t>(speedKey) & 0x3FFFFFu) << 10)
+                         | (static_cast<uint64_t>(sinceLastTap & 0x1FF) << 1)
+                         | static_cast<uint64_t>(tapped);
+
+    const auto inserted = m_merged.emplace(key, static_cast<uint32_t>(into.size()));
+    if (inserted.second) {
+        into.push(x, y, verticalSpeed, sinceLastTap, nearestMiss, tapped);
+    } else {
+        // same state reached twice, only the path with the larger nearest miss is worth following
+        const uint32_t existing = inserted.first->second;
+        if (nearestMiss > into.nearestMiss[existing]) {
+            into.x[existing] = x;
+            into.y[existing] = y;
+            into.verticalSpeed[existing] = verticalSpeed;
+            into.nearestMiss[existing] = nearestMiss;
+        }
+    }
+}
+
+std::pair<Distance, Action> BatchPlanner::bestAction(Motion motion,
+                                                     TimePoint::duration sinceLastTap,
+                                                     const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                                     Coordinate rightBoundary,
+                                                     std::optional<std::chrono::steady_clock::time_point> deadline) {
+    assert(!gaps.second || gaps.first);
+    const Obstacles obstacles = makeObstacles(gaps, m_groundLevel);
+    m_lastDepth = 0;
+    m_lastComplete = true;
+    m_lastNodes = 1;
+
+    float rootClearance;
+    clearanceScalar(&motion.position.x.val, &motion.position.y.val, &rootClearance, 0, 1, obstacles);
+    if (rootClearance == CRASHED) {
+        return {Distance{0}, Action::NONE};
+    }
+
+    if (motion.position.x > rightBoundary) {
+        return {Distance{std::numeric_limits<float>::max()}, Action::ANY};
+    }
+
+    const long quantum = SIMULATION_TIME_QUANTUM.count();
+    const float quantumHorizontal = (HORIZONTAL_SPEED * SIMULATION_TIME_QUANTUM).val;
+    // whatever the speed at the tap, the motion from the tap to the end of the quantum is always the same
+    const trajectory::VerticalStep afterJump = trajectory::verticalStep(JUMP_SPEED.val.val,
+                                                                        quantum - m_tapDelay.count());
+
+    m_current.clear();
+    m_merged.clear();
+    {
+        const float speed = motion.verticalSpeed.val.val;
+        const trajectory::VerticalStep noTap = trajectory::verticalStep(speed, quantum);
+        merge(m_current, motion.position.x.val + quantumHorizontal, motion.position.y.val + noTap.displacement,
+              noTap.speed, static_cast<int32_t>((sinceLastTap + SIMULATION_TIME_QUANTUM).count()), rootClearance,
+              false);
+
+        if (sinceLastTap > m_liftDelay) {
+            const float displacement = trajectory::verticalStep(speed, m_tapDelay.count()).displacement
+                                       + afterJump.displacement;
+            merge(m_current, motion.position.x.val + quantumHorizontal, motion.position.y.val + displacement,
+                  afterJump.speed, static_cast<int32_t>(quantum - m_tapDelay.count()), rootClearance, true);
+        }
+    }
+
+    // best nearest miss over all paths that made it to the right boundary, by the action taken at the root
+    float bestIfTap = 0;
+    float bestIfNoTap = 0;
+
+    while (m_current.size() > 0) {
+        ++m_lastDepth;
+        m_lastNodes += m_current.size();
+
+        const size_t count = m_current.size();
+        m_clearance.resize(count);
+        clearance(m_current.x.data(), m_current.y.data(), m_clearance.data(), count, obstacles);
+
+        const bool outOfTime = deadline && std::chrono::steady_clock::now() > deadline.value();
+
+        // drop the crashes, retire the nodes that made it and compact the rest to the front of m_current
+        size_t survivors = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (m_clearance[i] == CRASHED) {
+                continue;
+            }
+
+            float& best = m_current.tapped[i] ? bestIfTap : bestIfNoTap;
+            if (m_current.x[i] > rightBoundary.val) {
+                // same as Driver::bestActionR(), the clearance at the boundary doesn't count
+                best = std::max(best, m_current.nearestMiss[i]);
+                continue;
+            }
+
+            const float nearestMiss = std::min(m_current.nearestMiss[i], m_clearance[i]);
+            if (outOfTime) {
+                // like the anytime recursive search, surviving up to the horizon is as good as reaching the edge
+                best = std::max(best, nearestMiss);
+                m_lastComplete = false;
+                continue;
+            }
+
+            m_current.x[survivors] = m_current.x[i];
+            m_current.y[survivors] = m_current.y[i];
+            m_current.verticalSpeed[survivors] = m_current.verticalSpeed[i];
+            m_current.sinceLastTap[survivors] = m_current.sinceLastTap[i];
+            m_current.nearestMiss[survivors] = nearestMiss;
+            m_current.tapped[survivors] = m_current.tapped[i];
+            ++survivors;
+        }
+
+        if (survivors == 0) {
+            break;
+        }
+
+        m_noTapDisplacement.resize(survivors);
+        m_noTapSpeed.resize(survivors);
+        m_tapDisplacement.resize(survivors);
+        step(m_current.verticalSpeed.data(), m_noTapDisplacement.data(), m_noTapSpeed.data(), survivors, quantum);
+        step(m_current.verticalSpeed.data(), m_tapDisplacement.data(), nullptr, survivors, m_tapDelay.count());
+
+        m_next.clear();
+        m_merged.clear();
+        for (size_t i = 0; i < survivors; ++i) {
+            const float x = m_current.x[i] + quantumHorizontal;
+            merge(m_next, x, m_current.y[i] + m_noTapDisplacement[i], m_noTapSpeed[i],
+                  m_current.sinceLastTap[i] + static_cast<int32_t>(quantum), m_current.nearestMiss[i],
+                  m_current.tapped[i]);
+
+            if (m_current.sinceLastTap[i] > m_liftDelay.count()) {
+                merge(m_next, x, m_current.y[i] + m_tapDisplacement[i] + afterJump.displacement, afterJump.speed,
+                      static_cast<int32_t>(quantum - m_tapDelay.count()), m_current.nearestMiss[i],
+                      m_current.tapped[i]);
+            }
+        }
+
+        std::swap(m_current, m_next);
+    }
+
+    // same tie-breaking as Driver::bestActionFrom()
+    if (bestIfTap > bestIfNoTap) {
+        return {Distance{bestIfTap}, Action::TAP};
+    } else if (bestIfTap < bestIfNoTap) {
+        return {Distance{bestIfNoTap}, Action::NO_TAP};
+    } else if (bestIfTap == 0) {
+        return {Distance{0}, Action::NONE};
+    } else {
+        return {Distance{bestIfNoTap}, Action::NO_TAP};
+    }
+}
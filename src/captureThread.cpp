@@ -0,0 +1,47 @@
+#include "captureThread.hpp"
+#include "tracer.hpp"
+#include "util.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+CaptureThread::CaptureThread(VideoSource& source) : m_source{source}, m_thread{&CaptureThread::run, this} {}
+
+CaptureThread::~CaptureThread() {
+    m_running = false;
+    m_thread.join();
+}
+
+const CapturedFrame& CaptureThread::nextFrame() {
+    // Spinning rather than waiting on a condvar - the whole point is to pick up the frame as soon as it lands and
+    // we'd only be waiting for the remainder of a single capture anyway.
+    while (!m_ring.takeNewest()) {
+        if (m_failed) {
+            throw std::runtime_error{"Capture thread stopped"};
+        }
+        std::this_thread::yield();
+    }
+
+    return m_ring.front();
+}
+
+void CaptureThread::run() {
+    tracer::setThreadName("capture");
+    try {
+        while (m_running) {
+            TRACE_SPAN("capture");
+            CapturedFrame& frame = m_ring.back();
+
+            frame.captureStart = toTime(std::chrono::system_clock::now());
+            const cv::Mat& captured = m_source.captureFrame();
+            frame.captureEnd = toTime(std::chrono::system_clock::now());
+
+            // the source's own buffer is overwritten by the next capture, copyTo() reuses the slot's buffer
+            captured.copyTo(frame.image);
+            m_ring.publish();
+        }
+    } catch (std::exception& ex) {
+        std::cerr << "Capture failed: " << ex.what() << std::endl;
+        m_failed = true;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "frameRing.hpp"
+#include "VideoSource.hpp"
+
+/**
+ * Captures frames from a VideoSource on a dedicated thread, as fast as the source allows, so that capture overlaps with
+ * detection and planning on the main thread. The main thread always gets the newest frame, older ones are dropped.
+ *
+ * The source mustn't be used from any other thread while this is running. For X11 sources, this also means
+ * XInitThreads() must have been called before the display was opened if anything else (e.g. SimulatedArm) talks to it.
+ */
+class CaptureThread {
+public:
+    explicit CaptureThread(VideoSource& source);
+    ~CaptureThread();
+
+    CaptureThread(const CaptureThread&) = delete;
+    CaptureThread& operator=(const CaptureThread&) = delete;
+
+    /// Waits for a frame newer than the one returned last time. The frame stays valid until the next call.
+    /// @throws std::runtime_error if the capture thread has failed
+    const CapturedFrame& nextFrame();
+
+    uint64_t droppedFrames() const {
+        return m_ring.dropped();
+    }
+
+private:
+    void run();
+
+    VideoSource& m_source;
+    FrameRing m_ring;
+    std::atomic<bool> m_running{true};
+    std::atomic<bool> m_failed{false};
+    std::thread m_thread; // last, so everything else is ready by the time it starts
+};
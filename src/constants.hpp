@@ -7,7 +7,7 @@ using namespace std::literals::chrono_literals; // propagate when including this
 /*
  * These should be all constants that control the simulation (e.g. physical constants) plus flight control
  * (e.g. safety margins). There are a few more in featureDetector.cpp - those are fairly stable and shouldn't
- * need too much tinkering.
+ * need too much tinkering. The pipe geometry is here rather than there because GameSimulator draws the same pipes.
  * Unit of length is the width of the score box (the one that shows when you crash), including the border
  */
 
@@ -33,8 +33,41 @@ static constexpr Distance GROUND_SAFETY_BUFFER{0.015};
 
 static constexpr Distance BIRD_RADIUS{0.062f};
 
+// pipe geometry, measured off the screen
+static constexpr Distance PIPE_SPACING{0.45}; // rough distance between adjacent pipe edges
+static constexpr Distance PIPE_WIDTH{0.251f};
+static constexpr Distance GAP_HEIGHT{0.487f};
+
 static constexpr const TimePoint::duration SIMULATION_TIME_QUANTUM{75};
 
+// virtual time between capturing a frame and acting on it in the offline tools, stands in for the time detection takes
+// live
+static constexpr TimePoint::duration VIRTUAL_PROCESSING_DELAY{1};
+
+// Adaptive stepping (Driver::setAdaptiveStep()) takes steps of up to this many search quanta in open space, i.e. while
+// the bird's clearance (from the pipes and the ground) is above ADAPTIVE_COARSE_CLEARANCE and the next pipe is further
+// away than the step goes. The step halves as either shrinks.
+static constexpr int ADAPTIVE_MAX_STEP_QUANTA = 4;
+static constexpr Distance ADAPTIVE_COARSE_CLEARANCE{0.124f}; // two bird radii
+
+// Search states closer than this are considered the same by the transposition table in Driver::bestActionR(). Coarser
+// values mean more reuse (faster search) but paths that are merged may in reality differ by up to this much.
+static constexpr Distance TRANSPOSITION_POSITION_QUANTUM{0.002f};
+static constexpr Speed TRANSPOSITION_SPEED_QUANTUM{{0.00002f}};
+
+// Policy table decisions (Driver::setPolicyTable()) are for the centres of the grid cells around the state, so only the
+// ones with this much clearance are trusted. And the table only applies if the ground and the right boundary are within
+// the tolerance of where they were when it was computed.
+static constexpr Distance POLICY_MIN_CLEARANCE{0.02f};
+static constexpr Distance POLICY_GEOMETRY_TOLERANCE{0.02f};
+
+// how long the anytime planner (Driver::setPlanningBudget()) may search per frame before acting on what it has
+static constexpr std::chrono::microseconds PLANNING_TIME_BUDGET = 2ms;
+
+// the window shows at most one frame per interval (~30 fps), the ones in between are skipped rather than slowing down
+// the main loop (see RenderThread)
+static constexpr std::chrono::milliseconds RENDER_INTERVAL = 33ms;
+
 // the point during captureFrame() at which the actual state of the underlying image is captured
 // (accounting for memory transfer etc.), between 0.0 and 1.0
 static constexpr double CAPTURE_POINT = 0.0;
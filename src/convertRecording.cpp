@@ -0,0 +1,21 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "recordingFile.hpp"
+
+// Converts an XML recording (as written by cv::FileStorage) into the binary format Recording now loads.
+// usage: convertRecording [input.xml [output.fbr]]
+int main(int argc, char** argv) {
+    const std::string input = argc > 1 ? argv[1] : "recording.xml";
+    const std::string output = argc > 2 ? argv[2] : "recording.fbr";
+
+    try {
+        std::cout << "Converting " << input << " to " << output << std::endl;
+        convertLegacyRecording(input, output);
+    } catch (std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
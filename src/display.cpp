@@ -2,9 +2,9 @@
 #include "util.hpp"
 
 #include <stdexcept>
+#include <thread>
 
-#include "opencv2/highgui/highgui.hpp"
-#include "opencv2/imgproc/imgproc.hpp"
+#include "constants.hpp"
 
 const std::string VideoFeed::FEED_NAME = "Original";
 
@@ -15,39 +15,112 @@ const static std::string BOTTOM_RIGHT_KEY = "bottom_right";
 const static std::string VIEWPORT_HEIGHT_KEY = "viewport_height";
 const static std::string UNIT_LENGTH_KEY = "unit_length";
 
-void mouseCallback(int event, int x, int y, int /*flags*/, void* userdata) {
-    if (event == cv::EVENT_LBUTTONDOWN) {
-        static_cast<VideoFeed *>(userdata)->mouseClick(x, y);
+VideoFeed::VideoFeed(VideoSource& source, bool headless) : m_source(source), m_headless(headless) {
+    if (m_headless) {
+        return;
     }
-}
-
-VideoFeed::VideoFeed(VideoSource& source) : m_source(source) {
-    cv::namedWindow(FEED_NAME);
-    cv::setMouseCallback(FEED_NAME, mouseCallback, this);
+#ifdef NO_HIGHGUI
+    throw std::invalid_argument("built without HighGUI, the feed can only be headless");
+#else
+    m_renderer = std::make_unique<RenderThread>(FEED_NAME, RENDER_INTERVAL);
     loadBoundaries();
+#endif
 }
 
 VideoFeed::~VideoFeed() {}
 
 void VideoFeed::captureFrame() {
-    m_currentFrame = m_source.get().captureFrame().clone();
+    const cv::Mat& captured = m_source.get().captureFrame();
+    // the source's buffer is overwritten by its next capture, so it's still a copy - but into a recycled buffer (the
+    // same one every time, unless someone - the recorder, the render thread - is holding on to the last frame)
+    m_currentPooledFrame.reset();
+    m_currentPooledFrame = m_framePool.acquire(captured.rows, captured.cols, captured.type());
+    captured.copyTo(m_currentPooledFrame.image());
+    m_currentFrame = m_currentPooledFrame.image();
+    m_overlays.clear();
+    m_auxiliary.clear();
 }
 
-void VideoFeed::show() const {
-    cv::imshow(FEED_NAME, m_currentFrame);
+void VideoFeed::show() {
+#ifndef NO_HIGHGUI
+    if (m_headless) {
+        return;
+    }
+    if (!m_renderer->wantsFrame()) {
+        ++m_skippedFrames;
+        return;
+    }
+    // the render thread reads the frame in its own time: our pooled frames are never written to again once captured
+    // (the next capture takes another buffer while this one's held), anything else may be, so it's copied
+    PooledFrame frame = m_currentPooledFrame;
+    if (!frame) {
+        frame = m_framePool.acquire(m_currentFrame.rows, m_currentFrame.cols, m_currentFrame.type());
+        m_currentFrame.copyTo(frame.image());
+    }
+    m_renderer->submit(std::move(frame), m_overlays, std::move(m_auxiliary));
+    m_auxiliary.clear();
+#endif
+}
+
+std::shared_ptr<const std::atomic<int>> VideoFeed::addTrackbar(const std::string& window, const std::string& name,
+                                                               int initial, int max) {
+#ifndef NO_HIGHGUI
+    if (!m_headless) {
+        return m_renderer->addTrackbar(window, name, initial, max);
+    }
+#endif
+    return std::make_shared<const std::atomic<int>>(initial);
+}
+
+void VideoFeed::showAuxiliary(const std::string& window, const cv::Mat& image) {
+#ifndef NO_HIGHGUI
+    // only copied if the frame is going to be shown, like the frame itself
+    if (m_headless || !m_renderer->wantsFrame()) {
+        return;
+    }
+    PooledFrame copy = m_framePool.acquire(image.rows, image.cols, image.type());
+    image.copyTo(copy.image());
+    m_auxiliary.emplace_back(window, std::move(copy));
+#endif
+}
+
+int VideoFeed::pollKey(std::chrono::milliseconds wait) {
+#ifndef NO_HIGHGUI
+    if (!m_headless) {
+        // clicks are applied here rather than in the window's callback, so that the boundaries are only ever touched
+        // from the thread that uses them
+        while (std::optional<RenderThread::Event> event = m_renderer->nextEvent(wait)) {
+            if (event->type == RenderThread::Event::Type::KEY) {
+                return event->key;
+            }
+            mouseClick(event->click.x, event->click.y);
+        }
+        return -1;
+    }
+#endif
+    std::this_thread::sleep_for(wait);
+    return -1;
 }
 
 void VideoFeed::mark(cv::Point loc, cv::Scalar color) {
-    cv::line(m_currentFrame, cv::Point(loc.x - 20, loc.y), cv::Point(loc.x + 20, loc.y), color, 2);
-    cv::line(m_currentFrame, cv::Point(loc.x, loc.y - 20), cv::Point(loc.x, loc.y + 20), color, 2);
+    if (m_headless) {
+        return; // nobody to see it
+    }
+    m_overlays.push_back({Overlay::Shape::MARK, loc, 0, color});
 }
 
 void VideoFeed::circle(Position center, Distance radius, cv::Scalar color) {
-    cv::circle(m_currentFrame, positionToPixel(center), distanceToPixels(radius), color, 2);
+    if (m_headless) {
+        return;
+    }
+    m_overlays.push_back({Overlay::Shape::CIRCLE, positionToPixel(center), distanceToPixels(radius), color});
 }
 
 void VideoFeed::filledCircle(Position center, Distance radius, cv::Scalar color) {
-    cv::circle(m_currentFrame, positionToPixel(center), distanceToPixels(radius), color, cv::FILLED);
+    if (m_headless) {
+        return;
+    }
+    m_overlays.push_back({Overlay::Shape::FILLED_CIRCLE, positionToPixel(center), distanceToPixels(radius), color});
 }
 
 void VideoFeed::mouseClick(int x, int y) {
@@ -105,15 +178,23 @@ void VideoFeed::loadBoundaries() {
 }
 
 void VideoFeed::deserialise(cv::FileStorage& storage) {
-    storage[BOTTOM_LEFT_KEY] >> m_frameBottomLeft;
-    storage[BOTTOM_RIGHT_KEY] >> m_frameBottomRight;
-    storage[VIEWPORT_HEIGHT_KEY] >> m_frameHeight;
-    storage[UNIT_LENGTH_KEY] >> m_unitLength;
-    m_boundariesKnown = true;
+    setViewport(deserialiseViewport(storage));
 }
 
 void VideoFeed::serialise(cv::FileStorage& storage) const {
-    assert(boundariesKnown());
-    storage << BOTTOM_LEFT_KEY << m_frameBottomLeft << BOTTOM_RIGHT_KEY << m_frameBottomRight
-            << VIEWPORT_HEIGHT_KEY << m_frameHeight << UNIT_LENGTH_KEY << m_unitLength;
+    serialiseViewport(storage, viewport());
+}
+
+VideoFeed::Viewport VideoFeed::deserialiseViewport(cv::FileStorage& storage) {
+    Viewport viewport;
+    storage[BOTTOM_LEFT_KEY] >> viewport.bottomLeft;
+    storage[BOTTOM_RIGHT_KEY] >> viewport.bottomRight;
+    storage[VIEWPORT_HEIGHT_KEY] >> viewport.height;
+    storage[UNIT_LENGTH_KEY] >> viewport.unitLength;
+    return viewport;
+}
+
+void VideoFeed::serialiseViewport(cv::FileStorage& storage, const Viewport& viewport) {
+    storage << BOTTOM_LEFT_KEY << viewport.bottomLeft << BOTTOM_RIGHT_KEY << viewport.bottomRight
+            << VIEWPORT_HEIGHT_KEY << viewport.height << UNIT_LENGTH_KEY << viewport.unitLength;
 }
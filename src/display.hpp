@@ -1,10 +1,16 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <string>
 
 #include "opencv2/videoio.hpp"
 
+#include "framePool.hpp"
 #include "gap.hpp"
+#include "renderThread.hpp"
 #include "units.hpp"
 #include "VideoSource.hpp"
 
@@ -12,15 +18,56 @@ class VideoFeed { //TODO find better name (or use namespace, Display conflicts w
     static const std::string FEED_NAME;
 
 public:
-    VideoFeed(VideoSource& source);
+    /// Where the game is within the frame, as selected by clicking around it.
+    struct Viewport {
+        cv::Point bottomLeft;
+        cv::Point bottomRight;
+        int height; // pixels
+        int unitLength; // pixels per unit of Distance
+    };
+
+    /// Unless headless, the window is shown by a RenderThread at most every RENDER_INTERVAL, frames in between are
+    /// skipped. Builds with NO_HIGHGUI defined (the tools that never open a window) only support headless feeds, and
+    /// throw std::invalid_argument otherwise.
+    /// @param headless no window - show() and the overlays do nothing, there are no keys and boundaries must be set
+    ///                 with setViewport() or loadBoundaries()
+    VideoFeed(VideoSource& source, bool headless = false);
     virtual ~VideoFeed();
 
+    /// Copies the next frame from the source into a pooled buffer. Starts a new draw list.
     void captureFrame();
-    void show() const;
+    /// Use a frame captured elsewhere (e.g. on a CaptureThread) instead of captureFrame(). The frame isn't copied, it's
+    /// only copied in show() if it's actually going to be shown. Starts a new draw list.
+    void setCurrentFrame(const cv::Mat& frame) {
+        m_currentPooledFrame.reset();
+        m_currentFrame = frame;
+        m_overlays.clear();
+        m_auxiliary.clear();
+    }
+    /// Hands the current frame and its overlays to the render thread, unless it's not due another one yet.
+    void show();
+    /// Applies the clicks in the window since the last call (see mouseClick()) and returns the oldest key pressed
+    /// since, -1 if none. Waits up to `wait` for either.
+    int pollKey(std::chrono::milliseconds wait = std::chrono::milliseconds::zero());
+
+    /// A slider for tuning something at run time (e.g. playback speed, detection thresholds) in a window of its own.
+    /// The returned value follows the slider, or stays at `initial` when headless.
+    std::shared_ptr<const std::atomic<int>> addTrackbar(const std::string& window, const std::string& name, int initial,
+                                                        int max);
+    /// Shows `image` (e.g. a mask while calibrating) in a window of its own along with the current frame, if that's
+    /// going to be shown. Copied, so it can be reused straight away.
+    void showAuxiliary(const std::string& window, const cv::Mat& image);
+
+    /// Frames show() didn't pass on, because the render thread was still busy or not due another one.
+    uint64_t skippedFrames() const {
+        return m_skippedFrames;
+    }
     double capturePoint() const {
         return m_source.get().capturePoint();
     };
 
+    // Overlays go on the current frame's draw list, they're drawn over (a copy of) the frame when it's shown. The frame
+    // itself stays as captured.
     void mark(cv::Point loc, cv::Scalar color);
     void circle(Position center, Distance radius, cv::Scalar color);
     void filledCircle(Position center, Distance radius, cv::Scalar color);
@@ -41,6 +88,12 @@ public:
         return m_currentFrame;
     }
 
+    /// The buffer behind getCurrentFrame(), to keep it (e.g. while it's being recorded) without copying. Empty if the
+    /// frame came from setCurrentFrame().
+    const PooledFrame& getCurrentPooledFrame() const {
+        return m_currentPooledFrame;
+    }
+
     Coordinate pixelXToPosition(int x) const {
         assert(boundariesKnown());
         return {static_cast<float>(x - m_frameBottomLeft.x) / m_unitLength};
@@ -83,15 +136,45 @@ public:
         return m_boundariesKnown;
     };
 
+    bool headless() const {
+        return m_headless;
+    }
+
+    Viewport viewport() const {
+        assert(boundariesKnown());
+        return {m_frameBottomLeft, m_frameBottomRight, m_frameHeight, m_unitLength};
+    }
+
+    void setViewport(const Viewport& viewport) {
+        m_frameBottomLeft = viewport.bottomLeft;
+        m_frameBottomRight = viewport.bottomRight;
+        m_frameHeight = viewport.height;
+        m_unitLength = viewport.unitLength;
+        m_boundariesKnown = true;
+    }
+
+    /// From the file they were saved to when last set by clicking, if there is one.
+    void loadBoundaries();
+
     void serialise(cv::FileStorage& storage) const;
     void deserialise(cv::FileStorage& storage);
+    static void serialiseViewport(cv::FileStorage& storage, const Viewport& viewport);
+    static Viewport deserialiseViewport(cv::FileStorage& storage);
 
 private:
     void saveBoundaries() const;
-    void loadBoundaries();
 
     cv::Mat m_currentFrame;
+    PooledFrame m_currentPooledFrame;
+    DrawList m_overlays;
+    AuxiliaryFrames m_auxiliary;
+    FramePool m_framePool;
     const std::reference_wrapper<VideoSource> m_source;
+    const bool m_headless;
+#ifndef NO_HIGHGUI
+    std::unique_ptr<RenderThread> m_renderer; // unless headless
+#endif
+    uint64_t m_skippedFrames{0};
 
     bool m_boundariesKnown{false};
     int m_currentClick{0};
@@ -2,10 +2,13 @@
 
 #include "util.hpp"
 #include "constants.hpp"
+#include "sweep.hpp"
+#include "tracer.hpp"
 
 #include <iostream>
 #include <deque>
 #include <chrono>
+#include <stdexcept>
 
 void markGap(const Gap& gap, VideoFeed& display) {
     display.mark(display.positionToPixel(gap.lowerLeft), cv::Scalar(255, 0, 0));
@@ -50,7 +53,10 @@ Motion Driver::predictMotion(Motion startingMotion, TimePoint::duration deltaT)
 }
 
 Driver::Driver(Arm& arm, VideoFeed& cam) : m_arm{arm}, m_disp{cam},
-        m_groundLevel(cam.pixelYToPosition(cam.getGroundLevel())), m_lastAction{Action::ANY} {
+        m_groundLevel(cam.pixelYToPosition(cam.getGroundLevel())), m_lastAction{Action::ANY},
+        m_batchPlanner{arm.tapDelay(), arm.liftDelay(), m_groundLevel} {
+    // big enough for a typical full-width search so we don't rehash mid-search
+    m_search.transpositions.reserve(1 << 14);
     // simplifies calculations (bestBestClearance()) if we can compute events between time quanta independently
     //TODO should throw
     assert(SIMULATION_TIME_QUANTUM > m_arm.tapDelay());
@@ -59,7 +65,7 @@ Driver::Driver(Arm& arm, VideoFeed& cam) : m_arm{arm}, m_disp{cam},
 void Driver::takeOver(Position birdPos) {
     // tap immediately so we know when the last tap happened
     m_arm.tap();
-    m_lastTapped = toTime(std::chrono::system_clock::now()) + m_arm.tapDelay();
+    m_lastTapped = m_clock() + m_arm.tapDelay();
 }
 
 std::optional<Distance> Driver::pipeClearance(const Gap& gap, const Position& pos) {
@@ -121,17 +127,454 @@ std::optional<Distance> Driver::minClearance(Position pos,
     }
 }
 
+template<typename Timing>
+std::optional<Distance> Driver::edgeClearance(const Motion& motion,
+                                              bool tap,
+                                              TimePoint::duration step,
+                                              const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                              const Timing& timing) const {
+    if (!m_sweptCollision && step == m_searchQuantum) {
+        return Distance{std::numeric_limits<float>::max()};
+    }
+
+    // same motion as child(), but kept piece by piece
+    sweep::Path path;
+    if (tap) {
+        const Motion atTap = path.fall(motion, timing.tapDelay());
+        path.fall(atTap.with(JUMP_SPEED), step - timing.tapDelay());
+    } else {
+        path.fall(motion, step);
+    }
+
+    Distance smallest{std::numeric_limits<float>::max()};
+    for (int i = 0; i < path.count; ++i) {
+        const sweep::Piece& piece = path.pieces[i];
+        if (sweep::verticalRange(piece).second + BIRD_RADIUS.val + GROUND_SAFETY_BUFFER.val > m_groundLevel.val) {
+            return {};
+        }
+        for (const std::optional<Gap>* gap : {&gaps.first, &gaps.second}) {
+            if (!*gap) {
+                continue;
+            }
+            const std::optional<Distance> clearance = sweep::pipeClearance(gap->value(), piece);
+            if (!clearance) {
+                return {};
+            }
+            smallest = std::min(smallest, clearance.value());
+        }
+    }
+    return smallest;
+}
+
+int Driver::stepQuanta(const Motion& motion, Distance clearance,
+                       const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps) const {
+    if (!m_adaptiveStep) {
+        return 1;
+    }
+    // the pipes' clearance doesn't cover the ground, which a long step falls towards
+    const Distance aboveGround = m_groundLevel - (motion.position.y + BIRD_RADIUS + GROUND_SAFETY_BUFFER);
+    clearance = std::min(clearance, aboveGround);
+    if (clearance <= ADAPTIVE_COARSE_CLEARANCE) {
+        return 1;
+    }
+
+    // the nearest pipe that isn't behind the bird yet, nothing ahead at all if the gaps are all behind
+    Distance toPipe{std::numeric_limits<float>::max()};
+    for (const std::optional<Gap>* gap : {&gaps.first, &gaps.second}) {
+        if (*gap && gap->value().lowerRight.x + BIRD_RADIUS > motion.position.x) {
+            toPipe = std::max(Distance{0}, gap->value().lowerLeft.x - BIRD_RADIUS - motion.position.x);
+            break;
+        }
+    }
+
+    // step so that there's room for another step of the same length before the pipe, i.e. we're back to single
+    // quanta by the time it matters, and halve it as the clearance shrinks towards ADAPTIVE_COARSE_CLEARANCE
+    int quanta = ADAPTIVE_MAX_STEP_QUANTA;
+    while (quanta > 1 && (HORIZONTAL_SPEED * (m_searchQuantum * quanta * 2) > toPipe
+                          || clearance < ADAPTIVE_COARSE_CLEARANCE * (quanta / 2))) {
+        quanta /= 2;
+    }
+    return quanta;
+}
+
+template<typename Timing>
+Driver::Child Driver::child(const Motion& motion, TimePoint::duration sinceLastTap, int quantaSinceTap, bool tap,
+                            int quanta, const Timing& timing) const {
+    Child next = tap ? Child{afterTap(motion, quantaSinceTap, m_searchQuantum, timing),
+                             m_searchQuantum - timing.tapDelay(), quantaAfterTap()}
+                     : Child{afterNoTap(motion, quantaSinceTap, m_searchQuantum, timing),
+                             sinceLastTap + m_searchQuantum, nextQuantaSinceTap(quantaSinceTap, timing)};
+    // the rest of a longer step is free fall, one quantum at a time so that the trajectory table still applies
+    for (int i = 1; i < quanta; ++i) {
+        next = {afterNoTap(next.motion, next.quantaSinceTap, m_searchQuantum, timing),
+                next.sinceLastTap + m_searchQuantum, nextQuantaSinceTap(next.quantaSinceTap, timing)};
+    }
+    return next;
+}
+
+size_t Driver::SearchKeyHash::operator()(const SearchKey& key) const {
+    // x is roughly the same for all states at a given depth so it contributes little, y and speed do the mixing
+    size_t hash = static_cast<uint32_t>(key.y);
+    hash = hash * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.verticalSpeed);
+    hash = hash * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.x);
+    hash = hash * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.sinceLastTap);
+    return hash ^ (hash >> 32);
+}
+
+template<typename Search>
+auto Driver::withArmTiming(Search&& search) const {
+    // checked every time rather than once, the arm's delays may change (e.g. when calibrating)
+    if (!m_armTimingAtRunTime) {
+        if (PhysicalArmTiming::matches(m_arm)) {
+            return search(PhysicalArmTiming{});
+        } else if (SimulatedArmTiming::matches(m_arm)) {
+            return search(SimulatedArmTiming{});
+        }
+    }
+    return search(RuntimeArmTiming{m_arm});
+}
+
+template<typename Timing>
+Driver::SearchKey Driver::searchKey(const Motion& motion, TimePoint::duration sinceLastTap,
+                                    const Timing& timing) const {
+    // once the arm is ready to tap again, it stays ready until we tap, so the exact time since the tap doesn't matter
+    const TimePoint::duration cooldown = std::min(sinceLastTap,
+                                                  TimePoint::duration{timing.liftDelay()} + TimePoint::duration{1});
+
+    return {static_cast<int32_t>(std::lround(motion.position.x.val / TRANSPOSITION_POSITION_QUANTUM.val)),
+            static_cast<int32_t>(std::lround(motion.position.y.val / TRANSPOSITION_POSITION_QUANTUM.val)),
+            static_cast<int32_t>(std::lround(motion.verticalSpeed.val.val / TRANSPOSITION_SPEED_QUANTUM.val.val)),
+            static_cast<int32_t>(cooldown.count())};
+}
+
 Driver::Action Driver::bestAction(Motion motion,
                                   TimePoint::duration sinceLastTap,
                                   const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps) const {
-    return bestActionR(motion, sinceLastTap, gaps, Distance{std::numeric_limits<float>::max()}).second;
+    const auto searchStart = std::chrono::steady_clock::now();
+
+    if (m_policyTable) {
+        const std::optional<PolicyTable::Decision> decision = policyDecision(motion, sinceLastTap, gaps);
+        if (decision) {
+            // the plan would be out of date by the time we search again
+            m_plan.clear();
+            m_lastSearch = {0, true, 0, std::chrono::duration_cast<std::chrono::microseconds>(
+                                                std::chrono::steady_clock::now() - searchStart),
+                            false, decision->clearance, true};
+            return decision->action;
+        }
+    }
+
+    Action best = Action::NONE;
+    if (m_plannerEngine == PlannerEngine::BATCH) {
+        // the batch planner is anytime by construction, it just stops expanding levels when it runs out of time
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        if (m_planningBudget) {
+            deadline = searchStart + m_planningBudget.value();
+        }
+        const std::pair<Distance, Action> batchBest = m_batchPlanner.bestAction(
+                motion, sinceLastTap, gaps, m_disp.pixelXToPosition(m_disp.getRightBoundary()), deadline);
+        best = batchBest.second;
+        m_lastSearch = {m_batchPlanner.lastDepth(), m_batchPlanner.lastComplete(), m_batchPlanner.lastNodes(), {},
+                        false, batchBest.first};
+    } else {
+        // Without a budget, this is a single iteration over the whole tree. With one, it's iterative deepening - each
+        // iteration redoes the shallower ones but the cost is dominated by the deepest one anyway. The first iteration
+        // is a handful of nodes and always completes so that we have something to act on.
+        // the previous decision's plan, if it still works, is what the search has to beat
+        std::optional<Distance> planBound;
+        if (m_warmStart && m_plannerEngine == PlannerEngine::RECURSIVE && !m_plan.empty()) {
+            planBound = withArmTiming([&](const auto& timing) {
+                return planClearance(motion, sinceLastTap, gaps, timing);
+            });
+        }
+        m_searchPlan.clear();
+
+        m_lastSearch = {0, false, 0, {}};
+        for (int depthLimit = m_planningBudget ? 1 : std::numeric_limits<int>::max(); ; ++depthLimit) {
+            std::optional<std::chrono::steady_clock::time_point> deadline;
+            if (m_planningBudget && depthLimit > 1) {
+                deadline = searchStart + m_planningBudget.value();
+            }
+
+            const Iteration iteration = withArmTiming([&](const auto& timing) {
+                return m_plannerEngine == PlannerEngine::PARALLEL
+                       ? searchParallel(motion, sinceLastTap, gaps, depthLimit, deadline, timing)
+                       : searchSequential(motion, sinceLastTap, gaps, depthLimit, deadline, planBound, timing);
+            });
+            m_lastSearch.nodes += iteration.nodes;
+            if (iteration.aborted) {
+                break;
+            }
+
+            best = iteration.action;
+            m_lastSearch.clearance = iteration.clearance;
+            m_lastSearch.planReused = planBound && iteration.clearance <= planBound.value();
+            if (m_lastSearch.planReused) {
+                best = m_plan.front().action;
+                m_lastSearch.clearance = planBound.value();
+            }
+            m_lastSearch.depth = depthLimit;
+            if (!iteration.horizonReached) {
+                // every path either crashed or reached the right boundary, deeper iterations won't change anything
+                m_lastSearch.complete = true;
+                break;
+            }
+        }
+
+        if (m_warmStart && !m_lastSearch.planReused) {
+            // empty if the search found nothing, the next decision starts from scratch
+            m_plan.swap(m_searchPlan);
+        }
+    }
+
+    m_lastSearch.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()
+                                                                                 - searchStart);
+    return best;
+}
+
+template<typename Timing>
+Driver::Iteration Driver::searchSequential(Motion motion,
+                                           TimePoint::duration sinceLastTap,
+                                           const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                           int depthLimit,
+                                           std::optional<std::chrono::steady_clock::time_point> deadline,
+                                           std::optional<Distance> bound,
+                                           const Timing& timing) const {
+    m_search.reset(depthLimit, deadline, bound);
+    const std::pair<Distance, Action> best = bestActionR(motion, sinceLastTap, OFF_TRAJECTORY, 0, gaps,
+                                                         Distance{std::numeric_limits<float>::max()}, m_search, timing);
+    if (m_warmStart && !m_search.aborted && (!bound || best.first > bound.value())) {
+        recordPlan(motion, sinceLastTap, gaps, timing);
+    }
+    return {best.second, m_search.aborted, m_search.horizonReached, m_search.nodes, best.first};
+}
+
+void Driver::shiftPlan(TimePoint now) {
+    auto step = m_plan.begin();
+    for (; step != m_plan.end() && now - m_planStart >= m_searchQuantum * step->quanta; ++step) {
+        m_planStart += m_searchQuantum * step->quanta;
+    }
+    if (step == m_plan.begin() && step != m_plan.end() && now > m_planStart && step->action == Action::TAP) {
+        // we've acted on this step already, when it became the first one
+        step->action = Action::NO_TAP;
+    }
+    m_plan.erase(m_plan.begin(), step);
+    m_planElapsed = now - m_planStart;
 }
 
+template<typename Timing>
+std::optional<Distance> Driver::planClearance(Motion motion,
+                                              TimePoint::duration sinceLastTap,
+                                              const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                              const Timing& timing) const {
+    int quantaSinceTap = OFF_TRAJECTORY;
+    Distance smallest{std::numeric_limits<float>::max()};
+    TimePoint::duration elapsed = m_planElapsed;
+    // past the end of the plan (which ended at the right boundary before it was shifted), the bird falls freely
+    for (size_t i = 0; ; ++i) {
+        const std::optional<Distance> clearance = minClearance(motion.position, gaps);
+        if (!clearance) {
+            return {};
+        }
+        smallest = std::min(smallest, clearance.value());
+        if (motion.position.x > m_disp.pixelXToPosition(m_disp.getRightBoundary())) {
+            return smallest;
+        }
+
+        const bool tap = i < m_plan.size() && m_plan[i].action == Action::TAP;
+        if (tap && sinceLastTap <= timing.liftDelay()) {
+            return {};
+        }
+        int quanta;
+        if (i < m_plan.size() && elapsed > TimePoint::duration{0}) {
+            quanta = m_plan[i].quanta;
+        } else {
+            quanta = stepQuanta(motion, clearance.value(), gaps);
+            if (i < m_plan.size()) {
+                // the steps may come out differently from where the bird is now, that's what they'll be next time too
+                m_plan[i].quanta = quanta;
+            }
+        }
+        // the first step may be partly over, only the rest of it is left (and the rest of the plan is off the grid of
+        // the trajectory tables)
+        const TimePoint::duration duration = m_searchQuantum * quanta - elapsed;
+        if (tap && duration <= timing.tapDelay()) {
+            return {};
+        }
+        const std::optional<Distance> edge = edgeClearance(motion, tap, duration, gaps, timing);
+        if (!edge) {
+            return {};
+        }
+        smallest = std::min(smallest, edge.value());
+
+        if (elapsed == TimePoint::duration{0}) {
+            const Child next = child(motion, sinceLastTap, quantaSinceTap, tap, quanta, timing);
+            motion = next.motion;
+            sinceLastTap = next.sinceLastTap;
+            quantaSinceTap = next.quantaSinceTap;
+        } else {
+            motion = tap ? afterTap(motion, OFF_TRAJECTORY, duration, timing)
+                         : afterNoTap(motion, OFF_TRAJECTORY, duration, timing);
+            sinceLastTap = tap ? duration - timing.tapDelay() : sinceLastTap + duration;
+            elapsed = TimePoint::duration{0};
+        }
+    }
+}
+
+template<typename Timing>
+void Driver::recordPlan(Motion motion,
+                        TimePoint::duration sinceLastTap,
+                        const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                        const Timing& timing) const {
+    m_searchPlan.clear();
+    int quantaSinceTap = OFF_TRAJECTORY;
+    for (int depth = 0; depth < m_search.depthLimit; ) {
+        const std::optional<Distance> clearance = minClearance(motion.position, gaps);
+        if (!clearance || motion.position.x > m_disp.pixelXToPosition(m_disp.getRightBoundary())) {
+            break;
+        }
+        // every node on the best path was expanded, so it's in the table
+        const auto cached = m_search.transpositions.find(searchKey(motion, sinceLastTap, timing));
+        if (cached == m_search.transpositions.end()
+                || (cached->second.second != Action::TAP && cached->second.second != Action::NO_TAP)) {
+            break;
+        }
+
+        const bool tap = cached->second.second == Action::TAP;
+        const int quanta = stepQuanta(motion, clearance.value(), gaps);
+        m_searchPlan.push_back({cached->second.second, quanta});
+
+        const Child next = child(motion, sinceLastTap, quantaSinceTap, tap, quanta, timing);
+        motion = next.motion;
+        sinceLastTap = next.sinceLastTap;
+        quantaSinceTap = next.quantaSinceTap;
+        depth += quanta;
+    }
+}
+
+template<typename Timing, typename Frontier>
+std::pair<Distance, Driver::Action>
+Driver::searchTop(Motion motion,
+                  TimePoint::duration sinceLastTap,
+                  int quantaSinceTap,
+                  int depth,
+                  const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                  Distance nearestMissSoFar,
+                  int splitDepth,
+                  size_t* nodes,
+                  const Timing& timing,
+                  Frontier&& frontier) const {
+    const std::optional<Distance> currentClearance = minClearance(motion.position, gaps);
+    if (!currentClearance) {
+        return {Distance{0}, Action::NONE};
+    }
+
+    if (motion.position.x > m_disp.pixelXToPosition(m_disp.getRightBoundary())) {
+        return {nearestMissSoFar, Action::ANY};
+    }
+
+    if (depth >= splitDepth) {
+        return frontier(FrontierNode{motion, sinceLastTap, quantaSinceTap, depth, nearestMissSoFar});
+    }
+    if (nodes) {
+        ++*nodes;
+    }
+
+    // same as bestActionFrom(), except that children are capped by the whole path right away, like the search did
+    // before it had a transposition table - nothing up here is cached
+    const Distance smallestIncludingNow = std::min(nearestMissSoFar, currentClearance.value());
+
+    const int quanta = stepQuanta(motion, currentClearance.value(), gaps);
+
+    std::pair<Distance, Action> bestIfTap{Distance{0}, Action::NONE};
+    if (sinceLastTap > timing.liftDelay()) {
+        const std::optional<Distance> tapEdge = edgeClearance(motion, true, m_searchQuantum * quanta, gaps, timing);
+        if (tapEdge) {
+            const Child next = child(motion, sinceLastTap, quantaSinceTap, true, quanta, timing);
+            bestIfTap = searchTop(next.motion, next.sinceLastTap, next.quantaSinceTap, depth + quanta, gaps,
+                                  std::min(smallestIncludingNow, tapEdge.value()), splitDepth, nodes, timing, frontier);
+        }
+    }
+
+    std::pair<Distance, Action> bestIfNoTap{Distance{0}, Action::NONE};
+    const std::optional<Distance> noTapEdge = edgeClearance(motion, false, m_searchQuantum * quanta, gaps, timing);
+    if (noTapEdge) {
+        const Child next = child(motion, sinceLastTap, quantaSinceTap, false, quanta, timing);
+        bestIfNoTap = searchTop(next.motion, next.sinceLastTap, next.quantaSinceTap, depth + quanta, gaps,
+                                std::min(smallestIncludingNow, noTapEdge.value()), splitDepth, nodes, timing,
+                                frontier);
+    }
+
+    return chooseAction(bestIfTap, bestIfNoTap);
+}
+
+template<typename Timing>
+Driver::Iteration Driver::searchParallel(Motion motion,
+                                         TimePoint::duration sinceLastTap,
+                                         const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                         int depthLimit,
+                                         std::optional<std::chrono::steady_clock::time_point> deadline,
+                                         const Timing& timing) const {
+    assert(m_threadPool);
+    const Distance noMissYet{std::numeric_limits<float>::max()};
+    const int splitDepth = std::min(m_parallelSplitDepth, depthLimit);
+
+    // First walk the top of the tree just to find where it ends, then search the subtrees below those nodes
+    // concurrently and finally walk the top again, in the same order, feeding it the subtrees' results. The top is
+    // a few dozen nodes at most so doing it twice costs nothing compared to the subtrees. Its nodes are counted on the
+    // first walk only.
+    Iteration iteration{Action::NONE, false, false, 0, Distance{0}};
+    m_frontier.clear();
+    searchTop(motion, sinceLastTap, OFF_TRAJECTORY, 0, gaps, noMissYet, splitDepth, &iteration.nodes, timing,
+              [this](const FrontierNode& node) {
+                  m_frontier.push_back(node);
+                  return std::pair<Distance, Action>{Distance{0}, Action::NONE};
+              });
+
+    // each task gets its own transposition table, none of the search state is shared between threads
+    while (m_taskSearches.size() < m_frontier.size()) {
+        m_taskSearches.emplace_back();
+        m_taskSearches.back().transpositions.reserve(1 << 12);
+    }
+    m_frontierResults.resize(m_frontier.size());
+
+    m_threadPool->parallelFor(m_frontier.size(), [&](size_t i) {
+        const FrontierNode& node = m_frontier[i];
+        SearchContext& search = m_taskSearches[i];
+        search.reset(depthLimit, deadline);
+        m_frontierResults[i] = bestActionR(node.motion, node.sinceLastTap, node.quantaSinceTap, node.depth, gaps,
+                                           node.nearestMissSoFar, search, timing);
+    });
+
+    for (size_t i = 0; i < m_frontier.size(); ++i) {
+        iteration.aborted |= m_taskSearches[i].aborted;
+        iteration.horizonReached |= m_taskSearches[i].horizonReached;
+        iteration.nodes += m_taskSearches[i].nodes;
+    }
+
+    size_t nextResult = 0;
+    const std::pair<Distance, Action> best = searchTop(motion, sinceLastTap, OFF_TRAJECTORY, 0, gaps, noMissYet,
+                                                       splitDepth, nullptr, timing,
+                                                       [&](const FrontierNode&) {
+                                                           return m_frontierResults[nextResult++];
+                                                       });
+    iteration.action = best.second;
+    iteration.clearance = best.first;
+    assert(nextResult == m_frontier.size());
+
+    return iteration;
+}
+
+template<typename Timing>
 std::pair<Distance, Driver::Action>
 Driver::bestActionR(Motion motion,
                     TimePoint::duration sinceLastTap,
+                    int quantaSinceTap,
+                    int depth,
                     const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
-                    Distance nearestMissSoFar) const {
+                    Distance nearestMissSoFar,
+                    SearchContext& search,
+                    const Timing& timing) const {
     const std::optional<Distance> currentClearance = minClearance(motion.position, gaps);
     if (!currentClearance) {
         // we've crashed into something
@@ -143,45 +586,198 @@ Driver::bestActionR(Motion motion,
         return {nearestMissSoFar, Action::ANY};
     }
 
-    const Distance smallestIncludingNow = std::min(nearestMissSoFar, currentClearance.value());
+    if (search.bound && std::min(nearestMissSoFar, currentClearance.value()) <= search.bound.value()) {
+        // whatever happens from here, it's no better than the path we already have
+        return {std::min(nearestMissSoFar, currentClearance.value()), Action::ANY};
+    }
+
+    if (depth >= search.depthLimit) {
+        // as far as this iteration is concerned, surviving this long is as good as reaching the edge
+        search.horizonReached = true;
+        return {std::min(nearestMissSoFar, currentClearance.value()), Action::ANY};
+    }
+
+    // The best clearance from here on doesn't depend on how we got here, the path so far only caps it. So we cache
+    // the uncapped result (i.e. computed as if nearestMissSoFar was the current clearance) and apply the cap on the
+    // way out.
+    const SearchKey key = searchKey(motion, sinceLastTap, timing);
+    auto cached = search.transpositions.find(key);
+    if (cached == search.transpositions.end()) {
+        const std::pair<Distance, Action> best = bestActionFrom(motion, sinceLastTap, quantaSinceTap, depth, gaps,
+                                                                currentClearance.value(), search, timing);
+        if (search.aborted) {
+            // partial result, mustn't be cached (and nobody is going to look at it anyway)
+            return {Distance{0}, Action::NONE};
+        }
+        cached = search.transpositions.emplace(key, best).first;
+    }
+
+    const std::pair<Distance, Action>& best = cached->second;
+    if (best.second == Action::NONE) {
+        return best;
+    }
+
+    return {std::min(nearestMissSoFar, best.first), best.second};
+}
+
+// how many nodes to expand between looking at the clock
+static constexpr size_t DEADLINE_CHECK_INTERVAL = 64;
+
+template<typename Timing>
+std::pair<Distance, Driver::Action>
+Driver::bestActionFrom(Motion motion,
+                       TimePoint::duration sinceLastTap,
+                       int quantaSinceTap,
+                       int depth,
+                       const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                       Distance currentClearance,
+                       SearchContext& search,
+                       const Timing& timing) const {
+    ++search.nodes;
+    if (search.deadline && search.nodes % DEADLINE_CHECK_INTERVAL == 0
+            && std::chrono::steady_clock::now() > search.deadline.value()) {
+        search.aborted = true;
+    }
+
+    if (search.aborted) {
+        return {Distance{0}, Action::NONE};
+    }
+
+    // With swept collision, the way to each child is checked here. It only depends on `motion`, so the result can still
+    // be cached as the best from this state. So does the step, and `depth` always matches `motion`'s x.
+    const int quanta = stepQuanta(motion, currentClearance, gaps);
 
     std::pair<Distance, Action> bestIfTap{Distance{0}, Action::NONE};
     // depth-first search
     // try tapping if we're past cooldown
-    if (sinceLastTap > m_arm.liftDelay()) {
-        // project to the point of actual tap
-        const Motion atTap = predictMotion(motion, m_arm.tapDelay());
-        // then, compute motion from the tap until the next time quantum (with the new speed from tap)
-        const Motion atNextQuantum = predictMotion(atTap.with(JUMP_SPEED), SIMULATION_TIME_QUANTUM - m_arm.tapDelay());
-        bestIfTap = bestActionR(atNextQuantum, SIMULATION_TIME_QUANTUM - m_arm.tapDelay(), gaps,
-                                smallestIncludingNow);
+    if (sinceLastTap > timing.liftDelay()) {
+        const std::optional<Distance> tapEdge = edgeClearance(motion, true, m_searchQuantum * quanta, gaps, timing);
+        if (tapEdge) {
+            const Child next = child(motion, sinceLastTap, quantaSinceTap, true, quanta, timing);
+            bestIfTap = bestActionR(next.motion, next.sinceLastTap, next.quantaSinceTap, depth + quanta, gaps,
+                                    std::min(currentClearance, tapEdge.value()), search, timing);
+        }
     }
 
     // now try not tapping
-    std::pair<Distance, Action> bestIfNoTap = bestActionR(predictMotion(motion, SIMULATION_TIME_QUANTUM),
-                                                          sinceLastTap + SIMULATION_TIME_QUANTUM,
-                                                          gaps,
-                                                          smallestIncludingNow);
-
-    // Whichever action we choose, the best nearest clearance overall is going to be the smallest of:
-    //  - currentClearance
-    //  - nearestMissSoFar
-    //  - nearest clearance of whichever action we choose
+    std::pair<Distance, Action> bestIfNoTap{Distance{0}, Action::NONE};
+    const std::optional<Distance> noTapEdge = edgeClearance(motion, false, m_searchQuantum * quanta, gaps, timing);
+    if (noTapEdge) {
+        const Child next = child(motion, sinceLastTap, quantaSinceTap, false, quanta, timing);
+        bestIfNoTap = bestActionR(next.motion,
+                                  next.sinceLastTap,
+                                  next.quantaSinceTap,
+                                  depth + quanta,
+                                  gaps,
+                                  std::min(currentClearance, noTapEdge.value()),
+                                  search,
+                                  timing);
+    }
+
+    // Whichever action we choose, the best nearest clearance from here is going to be the smaller of currentClearance
+    // and the nearest clearance of whichever action we choose (the children have already been capped by the former,
+    // and by the way there). The path that got us here (nearestMissSoFar) is applied by bestActionR().
+    return chooseAction(bestIfTap, bestIfNoTap);
+}
+
+std::pair<Distance, Driver::Action> Driver::chooseAction(const std::pair<Distance, Action>& bestIfTap,
+                                                         const std::pair<Distance, Action>& bestIfNoTap) {
     if (bestIfTap.first > bestIfNoTap.first) {
         assert(bestIfTap.second != Action::NONE); // distance would be 0 otherwise
-        return {std::min(smallestIncludingNow, bestIfTap.first), Action::TAP};
+        return {bestIfTap.first, Action::TAP};
     } else if (bestIfTap.first < bestIfNoTap.first) {
         assert(bestIfNoTap.second != Action::NONE); // distance would be 0 otherwise
-        return {std::min(smallestIncludingNow, bestIfNoTap.first), Action::NO_TAP};
+        return {bestIfNoTap.first, Action::NO_TAP};
     } else {
         if (bestIfTap.first == Distance{0}) {
             // if tap and no-tap are equal and both zero, there's no good path
             return {Distance{0}, Action::NONE};
         } else {
             // otherwise just pick arbitrarily
-            return {std::min(smallestIncludingNow, bestIfNoTap.first), Action::NO_TAP};
+            return {bestIfNoTap.first, Action::NO_TAP};
+        }
+    }
+}
+
+template<typename Timing>
+Motion Driver::afterTap(const Motion& motion, int quantaSinceTap, TimePoint::duration quantum, const Timing& timing) {
+    // once we've tapped within the search, the trajectory is known in advance
+    if (timing.trajectory() && quantaSinceTap != OFF_TRAJECTORY) {
+        return timing.trajectory()->afterTap(motion, quantaSinceTap);
+    }
+
+    // project to the point of actual tap
+    const Motion atTap = predictMotion(motion, timing.tapDelay());
+    // then, compute motion from the tap until the next time quantum (with the new speed from tap)
+    return predictMotion(atTap.with(JUMP_SPEED), quantum - timing.tapDelay());
+}
+
+template<typename Timing>
+Motion Driver::afterNoTap(const Motion& motion, int quantaSinceTap, TimePoint::duration quantum,
+                          const Timing& timing) {
+    if (timing.trajectory() && quantaSinceTap != OFF_TRAJECTORY) {
+        return timing.trajectory()->afterNoTap(motion, quantaSinceTap);
+    }
+    return predictMotion(motion, quantum);
+}
+
+template<typename Timing>
+int Driver::nextQuantaSinceTap(int quantaSinceTap, const Timing& timing) {
+    return timing.trajectory() && quantaSinceTap != OFF_TRAJECTORY ? trajectory::Table::next(quantaSinceTap)
+                                                                    : OFF_TRAJECTORY;
+}
+
+void Driver::setSearchQuantum(TimePoint::duration quantum) {
+    if (quantum <= m_arm.tapDelay()) {
+        throw std::invalid_argument("search quantum must be longer than the arm's tap delay");
+    }
+    m_searchQuantum = quantum;
+}
+
+void Driver::setPolicyTable(std::shared_ptr<const PolicyTable> table) {
+    if (table) {
+        table->checkSearchSettings(m_arm.tapDelay(), m_arm.liftDelay(), m_searchQuantum, m_sweptCollision,
+                                   m_adaptiveStep);
+    }
+    m_policyTable = std::move(table);
+}
+
+std::optional<PolicyTable::Decision> Driver::policyDecision(const Motion& motion,
+                                                            TimePoint::duration sinceLastTap,
+                                                            const std::pair<std::optional<Gap>,
+                                                                            std::optional<Gap>>& gaps) const {
+    if (!m_policyTable->matchesGeometry(m_groundLevel,
+                                        m_disp.pixelXToPosition(m_disp.getRightBoundary()) - motion.position.x)) {
+        return {};
+    }
+
+    const std::optional<PolicyTable::Decision> decision = m_policyTable->lookup(motion, sinceLastTap, gaps);
+    if (!decision || decision->clearance < POLICY_MIN_CLEARANCE
+            || (decision->action != Action::TAP && decision->action != Action::NO_TAP)) {
+        return {};
+    }
+    // the table doesn't know about the lift delay, its cell may be just past it while we aren't
+    if (decision->action == Action::TAP && sinceLastTap <= m_arm.liftDelay()) {
+        return {};
+    }
+    return decision;
+}
+
+// how many subtrees to hand to the thread pool, per thread
+static constexpr unsigned PARALLEL_TASKS_PER_THREAD = 4;
+
+void Driver::setPlannerEngine(PlannerEngine engine) {
+    if (engine == PlannerEngine::PARALLEL && !m_threadPool) {
+        // started once and kept, so that no threads are spawned per decision
+        m_threadPool = std::make_unique<ThreadPool>();
+        // enough subtrees for the pool to balance the load, the tree doesn't branch on every level (tap cooldown)
+        const unsigned tasks = m_threadPool->threadCount() * PARALLEL_TASKS_PER_THREAD;
+        m_parallelSplitDepth = 1;
+        while ((1u << m_parallelSplitDepth) < tasks) {
+            ++m_parallelSplitDepth;
         }
     }
+    m_plannerEngine = engine;
 }
 
 void Driver::drive(std::optional<Position> birdPos, std::pair<std::optional<Gap>, std::optional<Gap>> gaps,
@@ -194,8 +790,8 @@ void Driver::drive(std::optional<Position> birdPos, std::pair<std::optional<Gap>
 
     // It would be nice to take current time as argument but finding the bird and calculating path takes time (although
     // I haven't measured). For greatest accuracy of the resulting m_lastTapped, let's get our own time from the clock.
-    // I guess we could take the clock as argument for testability, but there are no tests anyway :P
-    const TimePoint now = toTime(std::chrono::system_clock::now());
+    // The clock can be swapped for a virtual one when replaying.
+    const TimePoint now = m_clock();
     // We know where the bird is right now, we're only interested in computing the current speed.
     // We know when we last tapped and what the speed was at that point (JUMP_SPEED) so we can compute the new speed and
     // just overwrite the position with the detected one.
@@ -226,13 +822,30 @@ void Driver::drive(std::optional<Position> birdPos, std::pair<std::optional<Gap>
         return; // tap still pending
     }
 
-    const auto best = bestAction(startingMotion, now - m_lastTapped, gaps);
+    if (m_warmStart) {
+        shiftPlan(now);
+    }
+
+    Action best;
+    {
+        TRACE_SPAN("plan");
+        best = bestAction(startingMotion, now - m_lastTapped, gaps);
+    }
+    ++m_searchTotals.decisions;
+    m_searchTotals.nodes += m_lastSearch.nodes;
+    m_searchTotals.plansReused += m_lastSearch.planReused ? 1 : 0;
+    if (m_warmStart && !m_lastSearch.planReused) {
+        m_planStart = now;
+    }
+    WARN_UNLESS(m_lastSearch.complete, "planning budget exhausted, acting on a horizon of " << m_lastSearch.depth
+                                       << " quanta (" << m_lastSearch.nodes << " nodes)");
 
     if (best == Action::TAP) {
+        TRACE_SPAN("tap");
         m_arm.tap();
         // arm.tap() starts a new thread which does the tap so let's assume it exits immediately  and so tap delay
         // starts now
-        m_lastTapped = toTime(std::chrono::system_clock::now()) + m_arm.tapDelay();
+        m_lastTapped = m_clock() + m_arm.tapDelay();
     }
 
     static int c = 1;
@@ -3,23 +3,128 @@
 #include <deque>
 #include <memory>
 #include <chrono>
+#include <unordered_map>
 #include <variant>
 #include "opencv2/imgproc/imgproc.hpp"
-#include "opencv2/highgui/highgui.hpp"
+#include "action.hpp"
 #include "arm.hpp"
+#include "armTiming.hpp"
+#include "batchPlanner.hpp"
 #include "display.hpp"
 #include "featureDetector.hpp"
+#include "policyTable.hpp"
+#include "threadPool.hpp"
+#include "trajectory.hpp"
 #include "units.hpp"
 #include "util.hpp"
 
 class Driver {
 
 public:
+    using Action = ::Action;
+
     Driver(Arm& arm, VideoFeed& cam);
     void drive(std::optional<Position> birdPos, std::pair<std::optional<Gap>, std::optional<Gap>> gaps,
                TimePoint captureStart, TimePoint captureEnd);
     void takeOver(Position birdPos);
 
+    /// How far the last search got before it had to return.
+    struct SearchReport {
+        int depth; // in search quanta, of the deepest completed iteration
+        bool complete; // whether that iteration reached the right boundary on every surviving path
+        size_t nodes; // expanded in all iterations, including an abandoned one
+        std::chrono::microseconds elapsed;
+        bool planReused{false}; // acted on the previous decision's plan, the search found nothing better
+        Distance clearance{0}; // of the best path found
+        bool fromPolicy{false}; // looked up in the policy table, nothing was searched
+    };
+
+    /// Switches to the anytime planner: the search deepens one time quantum at a time and, once `budget` runs out,
+    /// acts on the deepest fully searched horizon. No value means search the whole tree, however long it takes.
+    void setPlanningBudget(std::optional<std::chrono::microseconds> budget) {
+        m_planningBudget = budget;
+    }
+
+    /// Where drive() and takeOver() get the current time from, the system clock by default. Planning budgets are
+    /// still measured in real time.
+    void setClock(Clock clock) {
+        m_clock = std::move(clock);
+    }
+
+    /// The search is compiled separately for the physical and the simulated arm's timing and, if the arm's delays match
+    /// either, uses that. Set this for arms whose delays are calibrated at run time, so that they're always asked.
+    void setArmTimingAtRunTime(bool atRunTime) {
+        m_armTimingAtRunTime = atRunTime;
+    }
+
+    /// Checks the bird's clearance all along its path between search nodes rather than just at the nodes, so that a
+    /// path can't clip the corner of a pipe in between. Needed for search quanta much longer than the default.
+    void setSweptCollision(bool swept) {
+        m_sweptCollision = swept;
+    }
+
+    /// Time between search nodes, SIMULATION_TIME_QUANTUM by default. A longer quantum makes for a much smaller tree
+    /// but also coarser tap timing. Must be longer than the arm's tap delay, taps have to land within the quantum
+    /// they're issued in.
+    void setSearchQuantum(TimePoint::duration quantum);
+
+    /// Steps the search by several quanta at a time in open space (see ADAPTIVE_MAX_STEP_QUANTA) and by single quanta
+    /// near pipes, so that most of the horizon costs a fraction of the nodes. Taps are only considered at the start
+    /// of a step. The longer steps are always checked for collisions all the way, as with setSweptCollision().
+    void setAdaptiveStep(bool adaptive) {
+        m_adaptiveStep = adaptive;
+    }
+
+    /// Keeps the best plan (the whole sequence of taps) of each decision for the next one. There, it's shifted by the
+    /// time that's passed and checked against the new state and gaps; if it still works, its clearance bounds the
+    /// search, which then only expands paths that could do better. Recursive engine only.
+    void setWarmStart(bool warmStart) {
+        m_warmStart = warmStart;
+        m_plan.clear();
+    }
+
+    /// Looks decisions up in `table` (see generatePolicy) before searching, the search is only a fallback for states
+    /// the table doesn't cover. Throws std::invalid_argument if it was computed for different arm delays or search
+    /// settings (quantum, swept collision, adaptive step - set those first). It's never used if the ground or the right
+    /// boundary aren't where it expects (see PolicyTable::warnUnlessMatches()). Null switches it off.
+    void setPolicyTable(std::shared_ptr<const PolicyTable> table);
+
+    enum class PlannerEngine {
+        RECURSIVE, // depth-first with a transposition table
+        BATCH, // breadth-first and vectorised, see BatchPlanner
+        PARALLEL // RECURSIVE, with the subtrees below the top few levels searched on all cores
+    };
+
+    void setPlannerEngine(PlannerEngine engine);
+
+    PlannerEngine plannerEngine() const {
+        return m_plannerEngine;
+    }
+
+    /// What drive() would do from the given state, without acting on it. lastSearch() has the details.
+    /// @param sinceLastTap since the tap actually landed
+    Action bestAction(Motion motion,
+                      TimePoint::duration sinceLastTap,
+                      const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps) const;
+
+    const SearchReport& lastSearch() const {
+        return m_lastSearch;
+    }
+
+    /// Over all the decisions drive() has made so far, for comparing search settings.
+    struct SearchTotals {
+        size_t decisions{0};
+        uint64_t nodes{0};
+        size_t plansReused{0}; // see setWarmStart()
+    };
+
+    const SearchTotals& searchTotals() const {
+        return m_searchTotals;
+    }
+
+    /// Where `motionNow` ends up `deltaT` later, without any taps in between.
+    static Motion predictMotion(Motion motionNow, TimePoint::duration deltaT);
+
     void predictFreefall(const std::vector<std::pair<TimePoint::duration, cv::Mat>>& recording,
                          size_t startFrame,
                          const FeatureDetector& detector);
@@ -34,11 +139,84 @@ public:
                          Speed initialSpeed) const;
 
 private:
-    enum class Action {
-        TAP,
-        NO_TAP,
-        ANY,
-        NONE
+    /// Search state quantized to TRANSPOSITION_*_QUANTUM, so that (nearly) the same state reached via different
+    /// sequences of taps is only expanded once per decision.
+    struct SearchKey {
+        int32_t x;
+        int32_t y;
+        int32_t verticalSpeed;
+        int32_t sinceLastTap; // clamped, anything past the lift delay is the same as far as the search is concerned
+
+        bool operator==(const SearchKey& other) const {
+            return x == other.x && y == other.y && verticalSpeed == other.verticalSpeed
+                   && sinceLastTap == other.sinceLastTap;
+        }
+    };
+
+    struct SearchKeyHash {
+        size_t operator()(const SearchKey& key) const;
+    };
+
+    /// Best (uncapped) clearance and action found from a given state, only valid for the gaps and depth limit it was
+    /// computed with.
+    using TranspositionTable = std::unordered_map<SearchKey, std::pair<Distance, Action>, SearchKeyHash>;
+
+    /// State of a single search iteration, threaded through the recursion.
+    struct SearchContext {
+        /// Starts a new iteration. Clears the table but keeps its buckets so we don't reallocate every frame.
+        void reset(int newDepthLimit, std::optional<std::chrono::steady_clock::time_point> newDeadline,
+                   std::optional<Distance> newBound = {}) {
+            transpositions.clear();
+            nodes = 0;
+            depthLimit = newDepthLimit;
+            deadline = newDeadline;
+            bound = newBound;
+            horizonReached = false;
+            aborted = false;
+        }
+
+        TranspositionTable transpositions;
+        int depthLimit{0};
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        // clearance we already have a path for, paths that can't beat it aren't expanded (and their results are only
+        // upper bounds)
+        std::optional<Distance> bound;
+        size_t nodes{0};
+        // some path was cut short by depthLimit rather than reaching the right boundary
+        bool horizonReached{false};
+        // ran past the deadline, results of this iteration are meaningless
+        bool aborted{false};
+    };
+
+    /// Outcome of searching the tree once, down to a given depth limit.
+    struct Iteration {
+        Action action;
+        bool aborted;
+        bool horizonReached;
+        size_t nodes;
+        Distance clearance{0}; // of the best path, only exact if above the search's bound
+    };
+
+    /// One step of a plan, as taken by the search from its root.
+    struct PlannedStep {
+        Action action; // TAP or NO_TAP
+        int quanta;
+    };
+
+    /// Where a search node leads to, some search quanta later.
+    struct Child {
+        Motion motion;
+        TimePoint::duration sinceLastTap;
+        int quantaSinceTap;
+    };
+
+    /// A node at the bottom of the top levels of the tree, whose subtree the parallel search hands to a worker.
+    struct FrontierNode {
+        Motion motion;
+        TimePoint::duration sinceLastTap;
+        int quantaSinceTap;
+        int depth;
+        Distance nearestMissSoFar;
     };
 
     Coordinate m_groundLevel;
@@ -47,28 +225,177 @@ private:
     VideoFeed& m_disp;
     TimePoint m_lastTapped;
     Action m_lastAction;
+    Clock m_clock{systemNow};
+
+    std::optional<std::chrono::microseconds> m_planningBudget;
+    PlannerEngine m_plannerEngine{PlannerEngine::RECURSIVE};
+
+    bool m_armTimingAtRunTime{false};
+    bool m_sweptCollision{false};
+    bool m_adaptiveStep{false};
+    bool m_warmStart{false};
+    std::shared_ptr<const PolicyTable> m_policyTable;
+    // the best plan found by (or reused for) the last decision, its first step started at m_planStart
+    mutable std::vector<PlannedStep> m_plan;
+    mutable std::vector<PlannedStep> m_searchPlan; // the last complete iteration's
+    TimePoint m_planStart;
+    TimePoint::duration m_planElapsed{0}; // into its first step, as of the last shiftPlan()
+    TimePoint::duration m_searchQuantum{SIMULATION_TIME_QUANTUM};
+    // search nodes whose vertical speed doesn't come from a tap within the search can't use the timing's trajectory
+    static constexpr int OFF_TRAJECTORY = -1;
+
+    // bestAction() is conceptually const, these are just reused scratch space and a record of what it did
+    mutable SearchContext m_search;
+    mutable SearchReport m_lastSearch{};
+    SearchTotals m_searchTotals;
+    mutable BatchPlanner m_batchPlanner;
+
+    std::unique_ptr<ThreadPool> m_threadPool; // only started once the parallel engine is selected
+    int m_parallelSplitDepth{1};
+    mutable std::vector<FrontierNode> m_frontier;
+    mutable std::vector<std::pair<Distance, Action>> m_frontierResults;
+    mutable std::vector<SearchContext> m_taskSearches; // one per frontier node
+
+    /// Calls `search` with the timing policy (see armTiming.hpp) that matches m_arm.
+    template<typename Search>
+    auto withArmTiming(Search&& search) const;
+
+    template<typename Timing>
+    SearchKey searchKey(const Motion& motion, TimePoint::duration sinceLastTap, const Timing& timing) const;
 
     std::optional<Distance> minClearance(Position pos, const std::pair<std::optional<Gap>,
                                          std::optional<Gap>>& gaps) const;
 
+    /// The smallest clearance along the bird's path over the next `step`, tapping right away or not. No value if it
+    /// crashes on the way. Without swept collision, single search quanta are only checked at the nodes (by
+    /// minClearance()) and this is always the maximum for them.
+    template<typename Timing>
+    std::optional<Distance> edgeClearance(const Motion& motion,
+                                          bool tap,
+                                          TimePoint::duration step,
+                                          const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                          const Timing& timing) const;
+
+    /// How many search quanta to step by from `motion`, always 1 unless adaptive stepping is on.
+    int stepQuanta(const Motion& motion, Distance clearance,
+                   const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps) const;
+
+    /// The node `quanta` search quanta after this one, tapping at its start or not.
+    template<typename Timing>
+    Child child(const Motion& motion, TimePoint::duration sinceLastTap, int quantaSinceTap, bool tap, int quanta,
+                const Timing& timing) const;
+
+    /// quantaSinceTap of the node after a tap, the trajectory tables are only computed for SIMULATION_TIME_QUANTUM.
+    int quantaAfterTap() const {
+        return m_searchQuantum == SIMULATION_TIME_QUANTUM ? 0 : OFF_TRAJECTORY;
+    }
+
     // should these be free functions? we'd need to make the constants public or pass them directly
     static Speed projectVerticalSpeed(Speed startingSpeed, TimePoint::duration deltaT);
-    static Motion predictMotion(Motion motionNow, TimePoint::duration deltaT);
     // no value if crashed
     static std::optional<Distance> pipeClearance(const Gap& gap, const Position& pos);
 
-    Action bestAction(Motion motion,
-                      TimePoint::duration sinceLastTap,
-                      const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps) const;
+    /// Only the table's confident decisions are taken, for the geometry it was computed for.
+    std::optional<PolicyTable::Decision> policyDecision(const Motion& motion,
+                                                        TimePoint::duration sinceLastTap,
+                                                        const std::pair<std::optional<Gap>,
+                                                                        std::optional<Gap>>& gaps) const;
+
+    template<typename Timing>
+    Iteration searchSequential(Motion motion,
+                               TimePoint::duration sinceLastTap,
+                               const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                               int depthLimit,
+                               std::optional<std::chrono::steady_clock::time_point> deadline,
+                               std::optional<Distance> bound,
+                               const Timing& timing) const;
+
+    /// Drops the steps of m_plan that are over by `now`, m_planStart becomes the start of the first one left.
+    void shiftPlan(TimePoint now);
 
-    /// Given current motion, how can we steer the bird through all visible pipes? Right now 'best' means 'first one
-    /// we can find with depth-first-search'.
+    /// Follows m_plan from `motion`, same as the search would but starting m_planElapsed into the first step, and
+    /// without tapping once it runs out, to the right boundary. No value if the plan no longer works.
+    template<typename Timing>
+    std::optional<Distance> planClearance(Motion motion,
+                                          TimePoint::duration sinceLastTap,
+                                          const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                          const Timing& timing) const;
+
+    /// Walks the best path of the search that just completed through its transposition table, into m_searchPlan.
+    template<typename Timing>
+    void recordPlan(Motion motion,
+                    TimePoint::duration sinceLastTap,
+                    const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                    const Timing& timing) const;
+
+    template<typename Timing>
+    Iteration searchParallel(Motion motion,
+                             TimePoint::duration sinceLastTap,
+                             const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                             int depthLimit,
+                             std::optional<std::chrono::steady_clock::time_point> deadline,
+                             const Timing& timing) const;
+
+    /// Plain recursion (no transposition table) over the top `splitDepth` levels of the tree. Nodes at that depth are
+    /// passed to `frontier`, which returns their (capped) result, same as bestActionR() would. The nodes expanded above
+    /// the frontier are added to `nodes`, if given.
+    template<typename Timing, typename Frontier>
+    std::pair<Distance, Action> searchTop(Motion motion,
+                                          TimePoint::duration sinceLastTap,
+                                          int quantaSinceTap,
+                                          int depth,
+                                          const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                          Distance nearestMissSoFar,
+                                          int splitDepth,
+                                          size_t* nodes,
+                                          const Timing& timing,
+                                          Frontier&& frontier) const;
+
+    /// Given current motion, how can we steer the bird through all visible pipes? Depth-first search, memoized in
+    /// the search's transposition table so that its cost grows roughly linearly with the horizon rather than
+    /// exponentially.
     /// @param sinceLastTap time from the actual physical tap, not since we last issued a tap request (i.e. takes
     ///                     arm delay into account)
+    /// @param quantaSinceTap index into the timing's trajectory if the last tap happened during this search, else
+    ///                       OFF_TRAJECTORY
+    /// @param depth number of search quanta from the root, paths are considered successful at search.depthLimit
     /// @returns the action that achieves the greatest nearest-approach to any obstacle and the distance of that
     ///          approach (can be {Distance{0}, NONE} if no path can be found from `motion`)
+    template<typename Timing>
     std::pair<Distance, Action> bestActionR(Motion motion,
                                             TimePoint::duration sinceLastTap,
+                                            int quantaSinceTap,
+                                            int depth,
                                             const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
-                                            Distance nearestMissSoFar) const;
+                                            Distance nearestMissSoFar,
+                                            SearchContext& search,
+                                            const Timing& timing) const;
+
+    /// Expands `motion` (which mustn't be a crash or past the right boundary) into the tap/no-tap subtrees, i.e. the
+    /// uncached part of bestActionR().
+    /// @param currentClearance clearance at `motion`, the result is capped by it (but not by the path so far, so that
+    ///                         it can be cached)
+    template<typename Timing>
+    std::pair<Distance, Action> bestActionFrom(Motion motion,
+                                               TimePoint::duration sinceLastTap,
+                                               int quantaSinceTap,
+                                               int depth,
+                                               const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps,
+                                               Distance currentClearance,
+                                               SearchContext& search,
+                                               const Timing& timing) const;
+
+    /// Picks between the results of the tap and no-tap subtrees, preferring not to tap when they're equally good.
+    static std::pair<Distance, Action> chooseAction(const std::pair<Distance, Action>& bestIfTap,
+                                                    const std::pair<Distance, Action>& bestIfNoTap);
+
+    /// Motion a search quantum from now if we tap right away (the tap lands after the arm's tap delay) or don't tap.
+    template<typename Timing>
+    static Motion afterTap(const Motion& motion, int quantaSinceTap, TimePoint::duration quantum,
+                           const Timing& timing);
+    template<typename Timing>
+    static Motion afterNoTap(const Motion& motion, int quantaSinceTap, TimePoint::duration quantum,
+                             const Timing& timing);
+    template<typename Timing>
+    static int nextQuantaSinceTap(int quantaSinceTap, const Timing& timing);
 };
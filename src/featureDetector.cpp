@@ -1,18 +1,28 @@
 #include "featureDetector.hpp"
 #include "display.hpp"
+#include "driver.hpp"
+#include "hsv.hpp"
 #include "util.hpp"
 #include "constants.hpp"
 
 #include "opencv2/imgproc/imgproc.hpp"
-#include "opencv2/highgui/highgui.hpp"
 
 #include <assert.h>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
-static constexpr Distance PIPE_SPACING{0.45}; // rough distance between adjacent pipe edges
 constexpr int SEARCH_WINDOW_SIZE = 40;
-constexpr Distance PIPE_WIDTH{0.251f};
-constexpr Distance GAP_HEIGHT{0.487f};
+// how far (in pixels) a tracked gap may be from where we expect it, to absorb capture timestamp jitter
+constexpr int TRACKING_TOLERANCE = 4;
+// Half the height of the window the bird is tracked in. A tap changes its speed by up to |JUMP_SPEED| +
+// TERMINAL_VELOCITY, which moves it ~0.06 away from the prediction in a 60Hz frame (a single BIRD_RADIUS), a couple
+// of radii either side leaves room for slower captures and the bird's own size.
+constexpr Distance BIRD_WINDOW_HALF_HEIGHT{BIRD_RADIUS.val * 3};
+// give up on the track if frames are further apart than this, the prediction is too uncertain
+constexpr TimePoint::duration BIRD_TRACK_MAX_GAP{100};
+// if the bird's area (in moments, i.e. 255 per pixel) is less than this, assume it's just noise
+constexpr double MIN_BIRD_AREA = 10000;
 constexpr int WHITE = 255;
 constexpr int BLACK = 0;
 
@@ -53,61 +63,147 @@ int PIPES_HIGH_V = 255;
 int MORPHOLOGICAL_OPENING_THRESHOLD = 3;
 int MORPHOLOGICAL_CLOSING_THRESHOLD = 13; // 40 // high values slow things down
 
+// read the globals each time, they're tweaked live when calibrating
+static hsv::Range birdRange() {
+    return {BIRD_LOW_H, BIRD_HIGH_H, BIRD_LOW_S, BIRD_HIGH_S, BIRD_LOW_V, BIRD_HIGH_V};
+}
+
+static hsv::Range beakRange() {
+    return {BEAK_LOW_H, BEAK_HIGH_H, BEAK_LOW_S, BEAK_HIGH_S, BEAK_LOW_V, BEAK_HIGH_V};
+}
+
+static hsv::Range pipesRange() {
+    return {PIPES_LOW_H, PIPES_HIGH_H, PIPES_LOW_S, PIPES_HIGH_S, PIPES_LOW_V, PIPES_HIGH_V};
+}
+
+// BGR or BGRA
+static hsv::Pixel hsvAt(const cv::Mat& frame, int x, int y) {
+    const uchar* bgr = frame.ptr<uchar>(y) + x * frame.channels();
+    return hsv::fromBgr(bgr[0], bgr[1], bgr[2]);
+}
+
 FeatureDetector::FeatureDetector(VideoFeed &disp) :
         m_display{disp}, m_lowSweepY{disp.getGroundLevel() - 10},
         m_pipeWidth(disp.distanceToPixels(PIPE_WIDTH)),
         m_gapHeight(disp.distanceToPixels(GAP_HEIGHT)) {
 #ifdef CALIBRATING_DETECTOR
-    cv::namedWindow("Pipe Control", cv::WINDOW_AUTOSIZE); //create a window called "Control"
-
-    // //Create trackbars in "Control" window
-    cv::createTrackbar("LowH", "Pipe Control", &PIPES_LOW_H, 180); //Hue (0 - 180)
-    cv::createTrackbar("HighH", "Pipe Control", &PIPES_HIGH_H, 180);
+    // the sliders live on the display's render thread, process() picks up their values
+    const auto calibrate = [this](const std::string& window, const std::string& name, int& value, int max) {
+        m_calibrationControls.emplace_back(&value, m_display.addTrackbar(window, name, value, max));
+    };
 
-    cv::createTrackbar("LowS", "Pipe Control", &PIPES_LOW_S, 255); //Saturation (0 - 255)
-    cv::createTrackbar("HighS", "Pipe Control", &PIPES_HIGH_S, 255);
+    calibrate("Pipe Control", "LowH", PIPES_LOW_H, 180); //Hue (0 - 180)
+    calibrate("Pipe Control", "HighH", PIPES_HIGH_H, 180);
 
-    cv::createTrackbar("LowV", "Pipe Control", &PIPES_LOW_V, 255); //Value (0 - 255)
-    cv::createTrackbar("HighV", "Pipe Control", &PIPES_HIGH_V, 255);
+    calibrate("Pipe Control", "LowS", PIPES_LOW_S, 255); //Saturation (0 - 255)
+    calibrate("Pipe Control", "HighS", PIPES_HIGH_S, 255);
 
-    cv::namedWindow("Bird Control", cv::WINDOW_AUTOSIZE); // create a window called "Control"
+    calibrate("Pipe Control", "LowV", PIPES_LOW_V, 255); //Value (0 - 255)
+    calibrate("Pipe Control", "HighV", PIPES_HIGH_V, 255);
 
-    //Create trackbars in "Control" window
-    cv::createTrackbar("LowH (bird)", "Bird Control", &BIRD_LOW_H, 180); // Hue (0 - 180)
-    cv::createTrackbar("HighH (bird)", "Bird Control", &BIRD_HIGH_H, 180);
+    calibrate("Bird Control", "LowH (bird)", BIRD_LOW_H, 180); // Hue (0 - 180)
+    calibrate("Bird Control", "HighH (bird)", BIRD_HIGH_H, 180);
 
-    cv::createTrackbar("LowS (bird)", "Bird Control", &BIRD_LOW_S, 255); // Saturation (0 - 255)
-    cv::createTrackbar("HighS (bird)", "Bird Control", &BIRD_HIGH_S, 255);
+    calibrate("Bird Control", "LowS (bird)", BIRD_LOW_S, 255); // Saturation (0 - 255)
+    calibrate("Bird Control", "HighS (bird)", BIRD_HIGH_S, 255);
 
-    cv::createTrackbar("LowV (bird)", "Bird Control", &BIRD_LOW_V, 255); // Value (0 - 255)
-    cv::createTrackbar("HighV (bird)", "Bird Control", &BIRD_HIGH_V, 255);
+    calibrate("Bird Control", "LowV (bird)", BIRD_LOW_V, 255); // Value (0 - 255)
+    calibrate("Bird Control", "HighV (bird)", BIRD_HIGH_V, 255);
 
-    cv::createTrackbar("LowH (beak)", "Bird Control", &BEAK_LOW_H, 180); // Hue (0 - 180)
-    cv::createTrackbar("HighH (beak)", "Bird Control", &BEAK_HIGH_H, 180);
+    calibrate("Bird Control", "LowH (beak)", BEAK_LOW_H, 180); // Hue (0 - 180)
+    calibrate("Bird Control", "HighH (beak)", BEAK_HIGH_H, 180);
 
-    cv::createTrackbar("LowS (beak)", "Bird Control", &BEAK_LOW_S, 255); // Saturation (0 - 255)
-    cv::createTrackbar("HighS (beak)", "Bird Control", &BEAK_HIGH_S, 255);
+    calibrate("Bird Control", "LowS (beak)", BEAK_LOW_S, 255); // Saturation (0 - 255)
+    calibrate("Bird Control", "HighS (beak)", BEAK_HIGH_S, 255);
 
-    cv::createTrackbar("LowV (beak)", "Bird Control", &BEAK_LOW_V, 255); // Value (0 - 255)
-    cv::createTrackbar("HighV (beak)", "Bird Control", &BEAK_HIGH_V, 255);
+    calibrate("Bird Control", "LowV (beak)", BEAK_LOW_V, 255); // Value (0 - 255)
+    calibrate("Bird Control", "HighV (beak)", BEAK_HIGH_V, 255);
 
-    // //Create trackbars in "Control" window
-    cv::createTrackbar("Opening", "Bird Control", &MORPHOLOGICAL_OPENING_THRESHOLD, 40);
-    cv::createTrackbar("Closing", "Bird Control", &MORPHOLOGICAL_CLOSING_THRESHOLD, 80);
+    calibrate("Bird Control", "Opening", MORPHOLOGICAL_OPENING_THRESHOLD, 40);
+    calibrate("Bird Control", "Closing", MORPHOLOGICAL_CLOSING_THRESHOLD, 80);
 #endif // CALIBRATING_DETECTOR
 }
 
+void FeatureDetector::setMode(Mode mode) {
+#ifdef CALIBRATING_DETECTOR
+    mode = Mode::FULL;
+#endif
+    m_mode = mode;
+    m_frame = cv::Mat();
+    m_birdThresholded = false;
+}
+
+void FeatureDetector::setPyramidScale(int scale) {
+    if (scale != 2 && scale != 4) {
+        throw std::invalid_argument("the pyramid scale must be 2 or 4, not " + std::to_string(scale));
+    }
+    m_pyramidScale = scale;
+}
+
+uchar FeatureDetector::worldPixel(int x, int y) const {
+    if (m_mode == Mode::FULL) {
+        return m_thresholdedWorld.ptr<uchar>(y)[x];
+    }
+
+    uchar& cached = m_worldCache.ptr<uchar>(y)[x];
+    if ((cached >> 1) != m_cacheEpoch) {
+        const bool white = hsv::inRange(hsvAt(m_frame, x, y), pipesRange());
+        cached = static_cast<uchar>((m_cacheEpoch << 1) | (white ? 1 : 0));
+    }
+    return (cached & 1) ? WHITE : BLACK;
+}
+
+uchar FeatureDetector::worldPixel(int x, int y, int step) const {
+    if (step == 1) {
+        return worldPixel(x, y);
+    }
+    assert(m_mode == Mode::PYRAMID && step == m_pyramidScale);
+    return m_coarseWorld.ptr<uchar>(y / step)[x / step];
+}
+
+// bird or beak coloured pixels of `region` of the frame
+static void thresholdBird(const cv::Mat& frame, const cv::Rect& region, cv::Mat& out) {
+    const hsv::Range bird = birdRange();
+    const hsv::Range beak = beakRange();
+    out.create(region.height, region.width, CV_8UC1);
+    for (int y = 0; y < region.height; ++y) {
+        uchar* row = out.ptr<uchar>(y);
+        for (int x = 0; x < region.width; ++x) {
+            const hsv::Pixel pixel = hsvAt(frame, region.x + x, region.y + y);
+            row[x] = hsv::inRange(pixel, bird) || hsv::inRange(pixel, beak) ? WHITE : BLACK;
+        }
+    }
+}
+
+// the bird only moves vertically, a couple of radii either side of its x coordinate covers it and the beak
+static cv::Range birdColumns(VideoFeed& display, int frameCols) {
+    const int birdX = display.coordinateXToPixel(BIRD_X_COORDINATE);
+    const int halfWidth = 2 * display.distanceToPixels(BIRD_RADIUS);
+    return {std::max(0, birdX - halfWidth), std::min(frameCols, birdX + halfWidth)};
+}
+
+void FeatureDetector::thresholdBirdLazily() const {
+    if (m_birdThresholded) {
+        return;
+    }
+    m_birdThresholded = true;
+
+    const cv::Range columns = birdColumns(m_display, m_frame.cols);
+    m_birdColumnX = columns.start;
+    thresholdBird(m_frame, cv::Rect(columns.start, 0, columns.size(), m_frame.rows), m_thresholdedBird);
+}
+
 // keep looking up this many pixels after finding what we're looking for to bridge gaps
 // within pipes (especially the vertical black segments around the crown of a pipe)
 static const int CONFIDENCE_BUFFER = 20;
-int FeatureDetector::lookUp(int x, int y, int lookFor) const {
+int FeatureDetector::lookUp(int x, int y, int lookFor, int step) const {
     int confidence = 0;
-    for (int row = y; row > 0; --row) {
-        if (m_thresholdedWorld.ptr<uchar>(row)[x] == lookFor) {
-            if (confidence == CONFIDENCE_BUFFER) {
+    for (int row = y; row > 0; row -= step) {
+        if (worldPixel(x, row, step) == lookFor) {
+            if (confidence >= CONFIDENCE_BUFFER) {
                 return row + confidence;
             } else {
-                ++confidence;
+                confidence += step;
             }
         } else {
             confidence = 0;
@@ -117,11 +213,11 @@ int FeatureDetector::lookUp(int x, int y, int lookFor) const {
     return -1;
 }
 
-int FeatureDetector::lookLeft(int x, int y, int lookFor) const {
+int FeatureDetector::lookLeft(int x, int y, int lookFor, int step) const {
     // 1.1 just in case we're exactly at the right edge
-    for (int i = x; i > x - m_pipeWidth * 1.1; --i) {
+    for (int i = x; i > x - m_pipeWidth * 1.1; i -= step) {
         // assuming no noise inside a pipe
-        if (m_thresholdedWorld.ptr<uchar>(y)[i] == lookFor) {
+        if (worldPixel(i, y, step) == lookFor) {
             return i;
         }
     }
@@ -129,16 +225,7 @@ int FeatureDetector::lookLeft(int x, int y, int lookFor) const {
     return -1;
 }
 
-std::optional<Gap> FeatureDetector::getGapAt(int x) const {
-    WARN_UNLESS(m_thresholdedWorld.ptr<uchar>(m_lowSweepY)[x] == WHITE, "looking for a gap at a non-white pixel");
-    const int gapY = lookUp(x, m_lowSweepY, BLACK); // find the bottom of the gap above
-    // look a little below the bottom of the gap to miss the notch around the crown
-    const int gapLeftX = lookLeft(x, gapY + 4, BLACK);
-
-    if (gapY == -1 || gapLeftX == -1) {
-        return {};
-    }
-
+Gap FeatureDetector::gapFromEdges(int gapLeftX, int gapY) const {
     Gap gap;
     gap.lowerLeft = Position{m_display.pixelXToPosition(gapLeftX), m_display.pixelYToPosition(gapY)};
     gap.upperLeft = Position{m_display.pixelXToPosition(gapLeftX), m_display.pixelYToPosition(gapY - m_gapHeight)};
@@ -165,52 +252,130 @@ std::optional<Gap> FeatureDetector::getGapAt(int x) const {
     gap.lowerLeft.y += vertOffset;
     gap.lowerRight.y += vertOffset;
 
-    return std::move(gap);
+    return gap;
+}
+
+std::optional<FeatureDetector::GapDetection> FeatureDetector::getGapAt(int x) const {
+    WARN_UNLESS(worldPixel(x, m_lowSweepY) == WHITE, "looking for a gap at a non-white pixel");
+    int gapY;
+    int gapLeftX;
+    if (m_mode == Mode::PYRAMID) {
+        // Find both edges roughly in the downsampled frame first, then properly from a couple of its pixels before
+        // them - the full resolution ray casts are then a few pixels long rather than most of the screen.
+        const int step = m_pyramidScale;
+        gapY = lookUp(x, m_lowSweepY, BLACK, step);
+        if (gapY != -1) {
+            gapY = lookUp(x, std::min(m_lowSweepY, gapY + 2 * step), BLACK);
+        }
+        // a row that's sampled from gapY + 4 or below, not from the crown's notch
+        const int coarseLeftX = gapY == -1 ? -1 : lookLeft(x, gapY + 4 + step - 1, BLACK, step);
+        gapLeftX = coarseLeftX == -1 ? -1 : lookLeft(std::min(x, (coarseLeftX / step + 2) * step), gapY + 4, BLACK);
+    } else {
+        gapY = lookUp(x, m_lowSweepY, BLACK); // find the bottom of the gap above
+        // look a little below the bottom of the gap to miss the notch around the crown
+        gapLeftX = lookLeft(x, gapY + 4, BLACK);
+    }
+
+    if (gapY == -1 || gapLeftX == -1) {
+        return {};
+    }
+
+    return GapDetection{gapFromEdges(gapLeftX, gapY), m_display.pixelXToPosition(x),
+                        m_display.pixelXToPosition(gapLeftX), gapY};
 }
 
-std::optional<Gap> FeatureDetector::findFirstGapAheadOf(int x) const {
+std::optional<FeatureDetector::GapDetection> FeatureDetector::findFirstGapAheadOf(int x) const {
     assert(m_display.boundariesKnown());
-    const uchar *row = m_thresholdedWorld.ptr<uchar>(m_lowSweepY);
     int rightBoundary = m_display.getRightBoundary();
+    const float minWhiteCount = static_cast<float>(SEARCH_WINDOW_SIZE) / 4;
     for (int searchX = x; searchX < rightBoundary; searchX += SEARCH_WINDOW_SIZE) {
         // Check the SEARCH_WINDOW_SIZE pixels ahead if we have a white block.
         // This works with te assumption that a row is composed sequences of solid black and solid white, with only
         // sporadic noise outside of the pipe. In the end, maxWhiteCount should be roughly equal to the length of the
         // white block within the current window and maxWhiteIndex will point to the end of that block - we'll then cast
         // a ray up from the mid point of the block to find the gap;
-        unsigned maxWhiteCount = 0;
-        unsigned maxWhiteIndex = 0;
-        unsigned currentWhiteCount = 0;
-
-        // We may not have a full search window if looking at a far pipe just emerging from the edge of the screen.
-        for (unsigned i = searchX; i < std::min(rightBoundary, searchX + SEARCH_WINDOW_SIZE); ++i) {
-            if (row[i] == WHITE) {
-                ++currentWhiteCount;
-                if (currentWhiteCount > maxWhiteCount) {
-                    maxWhiteCount = currentWhiteCount;
-                    maxWhiteIndex = i;
+        const auto whiteBlock = [&](int step) {
+            int maxWhiteCount = 0;
+            int maxWhiteIndex = 0;
+            int currentWhiteCount = 0;
+
+            // We may not have a full search window if looking at a far pipe just emerging from the edge of the screen.
+            for (int i = searchX; i < std::min(rightBoundary, searchX + SEARCH_WINDOW_SIZE); i += step) {
+                if (worldPixel(i, m_lowSweepY, step) == WHITE) {
+                    currentWhiteCount += step;
+                    if (currentWhiteCount > maxWhiteCount) {
+                        maxWhiteCount = currentWhiteCount;
+                        maxWhiteIndex = i;
+                    }
+                } else {
+                    currentWhiteCount = 0;
                 }
-            } else {
-                currentWhiteCount = 0;
+            }
+            return std::make_pair(maxWhiteCount, maxWhiteIndex);
+        };
+
+        if (m_mode == Mode::PYRAMID) {
+            // Most windows are all sky, skip those. The samples can miss up to a downsampled pixel's worth at either
+            // end of a block though, so anything that may be one is counted again properly - it's what the gap is
+            // found from.
+            const std::pair<int, int> coarse = whiteBlock(m_pyramidScale);
+            if (coarse.first + 2 * (m_pyramidScale - 1) < minWhiteCount) {
+                continue;
             }
         }
 
-        if (maxWhiteCount < static_cast<float>(SEARCH_WINDOW_SIZE) / 4) {
+        const std::pair<int, int> block = whiteBlock(1);
+        if (block.first < minWhiteCount) {
             continue;
         }
 
-        return getGapAt(maxWhiteIndex - maxWhiteCount / 2);
+        return getGapAt(block.second - block.first / 2);
     }
     return {};
 }
 
-std::pair<std::optional<Gap>, std::optional<Gap>> FeatureDetector::findGapsAheadOf(Position pos) const {
-    int x = m_display.positionToPixel(pos).x - m_display.distanceToPixels(BIRD_RADIUS);
-    std::optional<Gap> leftGap = findFirstGapAheadOf(x);
+std::optional<FeatureDetector::GapDetection> FeatureDetector::confirmGap(const GapDetection& carried) const {
+    const int expectedEdgeX = m_display.coordinateXToPixel(carried.edgeX);
+    const int probeX = m_display.coordinateXToPixel(carried.probeX);
+    const int gapY = carried.bottomY;
+    const int rightBoundary = m_display.getRightBoundary();
+    if (expectedEdgeX - TRACKING_TOLERANCE < 0 || expectedEdgeX + TRACKING_TOLERANCE >= rightBoundary
+            || probeX >= rightBoundary
+            || gapY - TRACKING_TOLERANCE < 0 || gapY + 4 >= m_lowSweepY) {
+        return {};
+    }
+
+    // Pipes only ever move horizontally, so the bottom of the gap must still be right where it was: pipe below, gap
+    // above. Probing either side of it rather than the exact boundary row keeps the crown's noise out of it.
+    if (worldPixel(probeX, m_lowSweepY) != WHITE || worldPixel(probeX, gapY + TRACKING_TOLERANCE) != WHITE
+            || worldPixel(probeX, gapY - TRACKING_TOLERANCE) != BLACK) {
+        return {};
+    }
+
+    // Same as getGapAt(), the edge is the first black pixel left of the pipe, just below the gap. If it's not within
+    // the tolerance, the pipe didn't move the way we thought it would and we'd better look properly.
+    if (worldPixel(expectedEdgeX + TRACKING_TOLERANCE, gapY + 4) == BLACK) {
+        return {};
+    }
+    for (int edgeX = expectedEdgeX + TRACKING_TOLERANCE - 1; edgeX >= expectedEdgeX - TRACKING_TOLERANCE; --edgeX) {
+        if (worldPixel(edgeX, gapY + 4) == BLACK) {
+            // re-anchor on what we've actually seen so that errors in the timestamps don't accumulate
+            const Distance shift = m_display.pixelXToPosition(edgeX) - carried.edgeX;
+            return GapDetection{gapFromEdges(edgeX, gapY), carried.probeX + shift,
+                                m_display.pixelXToPosition(edgeX), gapY};
+        }
+    }
+
+    return {};
+}
+
+std::pair<std::optional<FeatureDetector::GapDetection>, std::optional<FeatureDetector::GapDetection>>
+FeatureDetector::scanForGaps(int birdX) const {
+    std::optional<GapDetection> leftGap = findFirstGapAheadOf(birdX);
     if (leftGap.has_value()) {
         // we may be able to see the next gap as well (or part thereof)
-        std::optional<Gap> rightGap = findFirstGapAheadOf(
-                m_display.coordinateXToPixel(leftGap->lowerRight.x + PIPE_SPACING));
+        std::optional<GapDetection> rightGap = findFirstGapAheadOf(
+                m_display.coordinateXToPixel(leftGap->gap.lowerRight.x + PIPE_SPACING));
 
         return { std::move(leftGap), std::move(rightGap) };
     }
@@ -218,23 +383,180 @@ std::pair<std::optional<Gap>, std::optional<Gap>> FeatureDetector::findGapsAhead
     return { std::move(leftGap), {} };
 }
 
-std::optional<Position> FeatureDetector::findBird() const {
+std::optional<std::pair<std::optional<FeatureDetector::GapDetection>, std::optional<FeatureDetector::GapDetection>>>
+FeatureDetector::trackGaps(int birdX) const {
+    if (!m_trackedGaps.has_value() || !m_trackedGaps->gaps.first.has_value() || *m_frameTime < m_trackedGaps->detectedAt) {
+        return {};
+    }
+
+    // everything scrolls left at the same constant speed
+    const Distance moved = HORIZONTAL_SPEED * (*m_frameTime - m_trackedGaps->detectedAt);
+    const auto carry = [&](GapDetection gap) {
+        gap.probeX -= moved;
+        gap.edgeX -= moved;
+        return gap;
+    };
+
+    // once the first pipe is (nearly) behind us, a scan would pick a different pipe (with the second one becoming
+    // first) - let it, rather than trying to mirror its exact rules here
+    const GapDetection first = carry(*m_trackedGaps->gaps.first);
+    if (m_display.coordinateXToPixel(first.edgeX) + m_pipeWidth < birdX + SEARCH_WINDOW_SIZE / 4) {
+        return {};
+    }
+
+    std::optional<GapDetection> leftGap = confirmGap(first);
+    if (!leftGap.has_value()) {
+        return {};
+    }
+
+    std::optional<GapDetection> rightGap;
+    if (m_trackedGaps->gaps.second.has_value()) {
+        rightGap = confirmGap(carry(*m_trackedGaps->gaps.second));
+        if (!rightGap.has_value()) {
+            return {};
+        }
+    } else {
+        // nothing tracked yet, the next pipe may be entering the screen - only this part needs a scan
+        rightGap = findFirstGapAheadOf(m_display.coordinateXToPixel(leftGap->gap.lowerRight.x + PIPE_SPACING));
+    }
+
+    return std::make_pair(std::move(leftGap), std::move(rightGap));
+}
+
+std::pair<std::optional<Gap>, std::optional<Gap>> FeatureDetector::findGapsAheadOf(Position pos) const {
+    int x = m_display.positionToPixel(pos).x - m_display.distanceToPixels(BIRD_RADIUS);
+
+    std::pair<std::optional<GapDetection>, std::optional<GapDetection>> gaps;
+    if (m_gapTracking && m_frameTime.has_value()) {
+        if (auto tracked = trackGaps(x)) {
+            gaps = std::move(*tracked);
+            ++m_gapTrackingStats.tracked;
+        } else {
+            gaps = scanForGaps(x);
+            ++m_gapTrackingStats.scanned;
+        }
+        m_trackedGaps = TrackedGaps{*m_frameTime, gaps};
+    } else {
+        gaps = scanForGaps(x);
+    }
+
+    const auto toGap = [](const std::optional<GapDetection>& detection) -> std::optional<Gap> {
+        if (detection.has_value()) {
+            return detection->gap;
+        }
+        return {};
+    };
+    return { toGap(gaps.first), toGap(gaps.second) };
+}
+
+// row of the centroid of the thresholded pixels, relative to the top of `thresholded`
+static std::optional<int> centroidRow(const cv::Mat& thresholded) {
     //Calculate the moments of the thresholded image
-    cv::Moments oMoments = cv::moments(m_thresholdedBird);
-
-    double dM01 = oMoments.m01;
-    double dM10 = oMoments.m10;
-    double dArea = oMoments.m00;
-
-    // if the area <= 10000 - assume no object in the image (presumably due to noise)
-    if (dArea > 10000) {
-        //calculate the m_position of the ball
-        int posX = dM10 / dArea;
-        int posY = dM01 / dArea;
-        // Position pos = m_display.pixelToPosition(cv::Point(posX, posY));
+    const cv::Moments moments = cv::moments(thresholded);
+    if (moments.m00 > MIN_BIRD_AREA) {
+        return static_cast<int>(moments.m01 / moments.m00);
+    }
+    return {};
+}
+
+std::optional<int> FeatureDetector::searchForBird() const {
+    if (m_mode != Mode::FULL) {
+        thresholdBirdLazily();
+    }
+    return centroidRow(m_thresholdedBird);
+}
+
+std::optional<int> FeatureDetector::findBirdNear(int predictedY) const {
+    const int frameRows = m_mode != Mode::FULL ? m_frame.rows : m_thresholdedBird.rows;
+    const int frameCols = m_mode != Mode::FULL ? m_frame.cols : m_thresholdedWorld.cols;
+    const int halfHeight = m_display.distanceToPixels(BIRD_WINDOW_HALF_HEIGHT);
+    const int top = std::max(0, predictedY - halfHeight);
+    const int bottom = std::min(frameRows, predictedY + halfHeight);
+    const cv::Range columns = birdColumns(m_display, frameCols);
+    if (bottom <= top || columns.empty()) {
+        return {};
+    }
+
+    std::optional<int> row;
+    if (m_mode != Mode::FULL) {
+        thresholdBird(m_frame, cv::Rect(columns.start, top, columns.size(), bottom - top), m_birdWindow);
+        row = centroidRow(m_birdWindow);
+    } else {
+        // already thresholded, just narrow down the moments
+        const cv::Rect window = cv::Rect(columns.start - m_birdColumnX, top, columns.size(), bottom - top)
+                                & cv::Rect(0, 0, m_thresholdedBird.cols, m_thresholdedBird.rows);
+        row = centroidRow(m_thresholdedBird(window));
+    }
+    if (!row.has_value()) {
+        return {};
+    }
+
+    // If the bird is near an edge of the window (other than the edge of the frame), part of it may be outside and the
+    // centroid is off - better search properly than drift away from it.
+    const int birdY = top + *row;
+    const int radius = m_display.distanceToPixels(BIRD_RADIUS);
+    if ((top > 0 && birdY - top < radius) || (bottom < frameRows && bottom - birdY < radius)) {
+        return {};
+    }
+    return birdY;
+}
+
+std::optional<int> FeatureDetector::predictBirdY() const {
+    if (!m_birdTrack.has_value() || !m_frameTime.has_value()) {
+        return {};
+    }
+    const TimePoint::duration sinceSeen = *m_frameTime - m_birdTrack->seenAt;
+    if (sinceSeen <= TimePoint::duration::zero() || sinceSeen > BIRD_TRACK_MAX_GAP) {
+        return {};
+    }
+
+    // without a speed, the window is still a good bet for a bird that's not been tapped yet
+    const Speed speed = m_birdTrack->speed.value_or(Speed{{0}});
+    const Motion predicted = Driver::predictMotion(Motion{Position{BIRD_X_COORDINATE, m_birdTrack->y}, speed},
+                                                   sinceSeen);
+    return m_display.coordinateYToPixel(predicted.position.y);
+}
+
+void FeatureDetector::updateBirdTrack(std::optional<int> birdY) const {
+    if (!birdY.has_value() || !m_frameTime.has_value()) {
+        m_birdTrack.reset();
+        return;
+    }
+
+    const Coordinate y = m_display.pixelYToPosition(*birdY);
+    std::optional<Speed> speed;
+    if (m_birdTrack.has_value() && m_birdTrack->seenAt < *m_frameTime) {
+        const TimePoint::duration sinceSeen = *m_frameTime - m_birdTrack->seenAt;
+        speed = Speed{(y - m_birdTrack->y) / static_cast<float>(sinceSeen.count())};
+        // the estimate is noisy, keep it within what the game can actually do
+        speed = std::min(std::max(*speed, JUMP_SPEED), TERMINAL_VELOCITY);
+    } else if (m_birdTrack.has_value()) {
+        speed = m_birdTrack->speed; // same frame again
+    }
+    m_birdTrack = BirdTrack{*m_frameTime, y, speed};
+}
+
+std::optional<Position> FeatureDetector::findBird() const {
+    std::optional<int> birdY;
+    if (m_birdTracking) {
+        if (const std::optional<int> predictedY = predictBirdY()) {
+            birdY = findBirdNear(*predictedY);
+        }
+        if (birdY.has_value()) {
+            ++m_birdTrackingStats.tracked;
+        } else {
+            birdY = searchForBird();
+            ++m_birdTrackingStats.searched;
+        }
+        updateBirdTrack(birdY);
+    } else {
+        birdY = searchForBird();
+    }
+
+    if (birdY.has_value()) {
         // TODO x position is constant, but we should set it manually when defining
         //      viewport, not hardcoding
-        Position pos{BIRD_X_COORDINATE, m_display.pixelYToPosition(posY)};
+        Position pos{BIRD_X_COORDINATE, m_display.pixelYToPosition(*birdY)};
         pos.y.val -= 0.01;
 
         return pos;
@@ -243,50 +565,82 @@ std::optional<Position> FeatureDetector::findBird() const {
     return {};
 }
 
-void openClose(const cv::Mat& imgHsvIn, cv::Mat& imgOut, int lowH, int highH, int lowS, int highS, int lowV, int highV) {
-    cv::inRange(imgHsvIn, cv::Scalar(lowH, lowS, lowV), cv::Scalar(highH, highS, highV), imgOut); //Threshold the image
-
-    // this stuff is nice, but it's slow - we can get good results with some manual
-    // ray casting (at least with screen grab, will see how it goes with webcam)
-    //morphological opening (removes small objects from the foreground)
-    // cv::erode(imgOut, imgOut, getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(MORPHOLOGICAL_OPENING_THRESHOLD,
-    //                                                                             MORPHOLOGICAL_OPENING_THRESHOLD)));
-    // cv::dilate(imgOut, imgOut, getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(MORPHOLOGICAL_OPENING_THRESHOLD,
-    //                                                                              MORPHOLOGICAL_OPENING_THRESHOLD)));
-
-    //morphological closing (removes small holes from the foreground)
-    // cv::dilate(imgOut, imgOut, getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(MORPHOLOGICAL_CLOSING_THRESHOLD,
-    //                                                                              MORPHOLOGICAL_CLOSING_THRESHOLD)));
-    // cv::erode(imgOut, imgOut, getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(MORPHOLOGICAL_CLOSING_THRESHOLD,
-    //                                                                             MORPHOLOGICAL_CLOSING_THRESHOLD)));
-}
+void FeatureDetector::process(const cv::Mat& frame, std::optional<TimePoint> captureTime) {
+#ifdef CALIBRATING_DETECTOR
+    for (const auto& [value, control] : m_calibrationControls) {
+        *value = control->load();
+    }
+#endif
+    m_frameTime = captureTime;
+    if (!captureTime.has_value()) {
+        // can't tell how far the world (or the bird) has moved since
+        m_trackedGaps.reset();
+        m_birdTrack.reset();
+    }
 
-static cv::Mat imgHSV;
-void FeatureDetector::process(const cv::Mat& frame) {
+    if (m_mode != Mode::FULL) {
+        m_frame = frame;
+        m_birdThresholded = false;
 
-    cv::cvtColor(frame, imgHSV, cv::COLOR_BGR2HSV); //Convert the captured frame from BGR to HSV
+        if (m_worldCache.rows != frame.rows || m_worldCache.cols != frame.cols) {
+            m_worldCache = cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1);
+            m_cacheEpoch = 0;
+        }
+        // only 7 bits for the epoch, clear the cache when they run out rather than on every frame
+        if (++m_cacheEpoch == 128) {
+            m_worldCache.setTo(0);
+            m_cacheEpoch = 1;
+        }
+
+        if (m_mode == Mode::PYRAMID) {
+            // A pixel per block, no averaging - blending the colours at a pipe's edge would only blur it. They're
+            // gathered into a row first so that they're thresholded in one pass, like the full frame.
+            const hsv::Thresholds thresholds{pipesRange(), birdRange(), beakRange()};
+            const int step = m_pyramidScale;
+            const int channels = frame.channels();
+            m_coarseWorld.create((frame.rows + step - 1) / step, (frame.cols + step - 1) / step, CV_8UC1);
+            m_coarseRow.create(1, m_coarseWorld.cols, frame.type());
+            uchar* samples = m_coarseRow.ptr<uchar>(0);
+            for (int y = 0; y < m_coarseWorld.rows; ++y) {
+                const uchar* pixels = frame.ptr<uchar>(y * step);
+                for (int x = 0; x < m_coarseWorld.cols; ++x) {
+                    std::memcpy(samples + x * channels, pixels + x * step * channels, channels);
+                }
+                hsv::thresholdRow(samples, channels, m_coarseWorld.cols, thresholds, m_coarseWorld.ptr<uchar>(y),
+                                  nullptr);
+            }
+        }
+        return;
+    }
 
 #ifdef CALIBRATING_DETECTOR
     // process the entire frame so that we can add it to m_imgCombined
-    const cv::Rect birdColumn(0, 0, imgHSV.cols, imgHSV.rows);
+    const cv::Rect birdColumn(0, 0, frame.cols, frame.rows);
 #else
     // in 'production' we only need to process the column we know the bird occupies
-    const cv::Rect birdColumn(imgHSV.cols*0.2, 0, imgHSV.cols*0.4, imgHSV.rows);
+    const cv::Rect birdColumn(frame.cols*0.2, 0, frame.cols*0.4, frame.rows);
 #endif
 
-    // Crop the full image to that image contained by the rectangle birdColumn
-    // Note that this doesn't copy the data
-    cv::Mat croppedImage = imgHSV(birdColumn);
-
-    openClose(croppedImage, m_thresholdedBird, BIRD_LOW_H, BIRD_HIGH_H, BIRD_LOW_S, BIRD_HIGH_S, BIRD_LOW_V, BIRD_HIGH_V);
-    openClose(croppedImage, m_thresholdedBeak, BEAK_LOW_H, BEAK_HIGH_H, BEAK_LOW_S, BEAK_HIGH_S, BEAK_LOW_V,
-              BEAK_HIGH_V);
-    openClose(imgHSV, m_thresholdedWorld, PIPES_LOW_H, PIPES_HIGH_H, PIPES_LOW_S, PIPES_HIGH_S, PIPES_LOW_V, PIPES_HIGH_V);
-
-    m_thresholdedBird += m_thresholdedBeak;
+    // One pass over the frame, without ever converting it to HSV as a whole. Morphological opening/closing would clean
+    // the masks up nicely, but it's slow - we can get good results with some manual ray casting instead.
+    const hsv::Thresholds thresholds{pipesRange(), birdRange(), beakRange()};
+    const int channels = frame.channels();
+    const int birdRight = birdColumn.x + birdColumn.width;
+    m_thresholdedWorld.create(frame.rows, frame.cols, CV_8UC1);
+    m_thresholdedBird.create(frame.rows, birdColumn.width, CV_8UC1);
+    m_birdColumnX = birdColumn.x;
+    for (int y = 0; y < frame.rows; ++y) {
+        const uchar* pixels = frame.ptr<uchar>(y);
+        uchar* world = m_thresholdedWorld.ptr<uchar>(y);
+        hsv::thresholdRow(pixels, channels, birdColumn.x, thresholds, world, nullptr);
+        hsv::thresholdRow(pixels + birdColumn.x * channels, channels, birdColumn.width, thresholds,
+                          world + birdColumn.x, m_thresholdedBird.ptr<uchar>(y));
+        hsv::thresholdRow(pixels + birdRight * channels, channels, frame.cols - birdRight, thresholds,
+                          world + birdRight, nullptr);
+    }
 
 #ifdef CALIBRATING_DETECTOR
-    m_imgCombined = m_thresholdedWorld + m_thresholdedBird + m_thresholdedBeak;
-    cv::imshow("Combined", m_imgCombined);
+    m_imgCombined = m_thresholdedWorld + m_thresholdedBird;
+    m_display.showAuxiliary("Combined", m_imgCombined);
 #endif
 }
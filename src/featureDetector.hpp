@@ -1,6 +1,11 @@
 #pragma once
 
 #include <optional>
+#ifdef CALIBRATING_DETECTOR
+#include <atomic>
+#include <memory>
+#include <vector>
+#endif
 #include "gap.hpp"
 #include "units.hpp"
 
@@ -17,22 +22,130 @@ public:
     FeatureDetector(const FeatureDetector&) = delete;
     FeatureDetector(FeatureDetector&&) = delete;
 
+    enum class Mode {
+        FULL, // threshold the whole frame up front
+        LAZY, // classify pixels on demand, only where the ray casts and the bird search look
+        PYRAMID // threshold a downsampled frame up front, find the gaps in that and refine their edges on demand
+    };
+
+    /// LAZY and PYRAMID are ignored when calibrating, the trackbars need the whole frame thresholded.
+    void setMode(Mode mode);
+
+    /// How many pixels (each way) make up a pixel of PYRAMID's downsampled frame, 2 or 4. Throws std::invalid_argument
+    /// otherwise.
+    void setPyramidScale(int scale);
+
+    Mode mode() const {
+        return m_mode;
+    }
+
+    /// When tracking, findGapsAheadOf() carries the previous frame's gaps along with the scrolling world and only
+    /// checks they're still there with a few local probes, rather than scanning for them from scratch. Falls back to a
+    /// full scan whenever a pipe enters or leaves, or the probes disagree.
+    void setGapTracking(bool tracking) {
+        m_gapTracking = tracking;
+        m_trackedGaps.reset();
+    }
+
+    struct GapTrackingStats {
+        size_t tracked; // findGapsAheadOf() calls answered by the probes alone
+        size_t scanned; // calls that needed a full scan
+    };
+
+    GapTrackingStats gapTrackingStats() const {
+        return m_gapTrackingStats;
+    }
+
+    /// When tracking, findBird() predicts where the bird is from where it was in the previous frames and only looks at
+    /// a small window around that, the whole column is searched only when the bird isn't found there.
+    void setBirdTracking(bool tracking) {
+        m_birdTracking = tracking;
+        m_birdTrack.reset();
+    }
+
+    struct BirdTrackingStats {
+        size_t tracked; // findBird() calls that found the bird in the predicted window
+        size_t searched; // calls that needed the whole column
+    };
+
+    BirdTrackingStats birdTrackingStats() const {
+        return m_birdTrackingStats;
+    }
+
     // video frame in BGR format to perform feature detection on
-    void process(const cv::Mat& frame);
+    // In LAZY mode the frame isn't copied, it must stay unmodified until we're done detecting features in it.
+    // Gaps are only tracked across frames that come with their capture time.
+    void process(const cv::Mat& frame, std::optional<TimePoint> captureTime = {});
     std::pair<std::optional<Gap>, std::optional<Gap>> findGapsAheadOf(Position pos) const;
     std::optional<Position> findBird() const;
 
 private:
-    std::optional<Gap> findFirstGapAheadOf(int x) const;
-    std::optional<Gap> getGapAt(int x) const;
-    int lookUp(int x, int y, int lookFor) const;
-    int lookLeft(int x, int y, int lookFor) const;
+    /// A gap along with the raw measurements it was derived from, so it can be found again in the next frame.
+    struct GapDetection {
+        Gap gap;
+        Coordinate probeX; // where the ray was cast up from
+        Coordinate edgeX; // first pixel left of the pipe at the bottom of the gap
+        int bottomY; // first gap pixel above the lower pipe
+    };
+
+    std::optional<GapDetection> findFirstGapAheadOf(int x) const;
+    std::optional<GapDetection> getGapAt(int x) const;
+    /// Checks that a gap detected in an earlier frame (and moved along since) is still where we expect it.
+    std::optional<GapDetection> confirmGap(const GapDetection& carried) const;
+    Gap gapFromEdges(int gapLeftX, int gapY) const;
+    std::pair<std::optional<GapDetection>, std::optional<GapDetection>> scanForGaps(int birdX) const;
+    std::optional<std::pair<std::optional<GapDetection>, std::optional<GapDetection>>> trackGaps(int birdX) const;
+    /// With a `step` other than 1, only every `step`th pixel is looked at, in the downsampled frame (PYRAMID only).
+    int lookUp(int x, int y, int lookFor, int step = 1) const;
+    int lookLeft(int x, int y, int lookFor, int step = 1) const;
+    /// WHITE if the pixel has the colour of a pipe, BLACK otherwise.
+    uchar worldPixel(int x, int y) const;
+    /// Same, from the downsampled frame if `step` isn't 1 - for the block of pixels (x, y) is in.
+    uchar worldPixel(int x, int y, int step) const;
+    /// Thresholds the columns around the bird, unless already done for this frame.
+    void thresholdBirdLazily() const;
+    /// Pixel row of the bird's centre, searching the whole column around it.
+    std::optional<int> searchForBird() const;
+    /// Same, but only within a window around where the bird is expected to be.
+    std::optional<int> findBirdNear(int predictedY) const;
+    std::optional<int> predictBirdY() const;
+    void updateBirdTrack(std::optional<int> birdY) const;
+
+    Mode m_mode{Mode::FULL};
+    cv::Mat m_frame; // LAZY and PYRAMID only, shares the data with the frame passed to process()
+    // LAZY and PYRAMID only, (epoch << 1) | is-white per pixel, entries from an earlier epoch are stale
+    mutable cv::Mat m_worldCache;
+    uchar m_cacheEpoch{0};
+    mutable bool m_birdThresholded{false};
+    mutable int m_birdColumnX{0}; // frame column of the first column of m_thresholdedBird
+
+    bool m_birdTracking{false};
+    struct BirdTrack {
+        TimePoint seenAt;
+        Coordinate y;
+        std::optional<Speed> speed; // only known once the bird's been seen in two consecutive frames
+    };
+    mutable std::optional<BirdTrack> m_birdTrack;
+    mutable BirdTrackingStats m_birdTrackingStats{};
+    mutable cv::Mat m_birdWindow; // LAZY and PYRAMID only, the thresholded window around the predicted position
+
+    bool m_gapTracking{false};
+    std::optional<TimePoint> m_frameTime;
+    struct TrackedGaps {
+        TimePoint detectedAt;
+        std::pair<std::optional<GapDetection>, std::optional<GapDetection>> gaps;
+    };
+    mutable std::optional<TrackedGaps> m_trackedGaps;
+    mutable GapTrackingStats m_gapTrackingStats{};
 
-    cv::Mat m_thresholdedBird;
-    cv::Mat m_thresholdedBeak;
+    mutable cv::Mat m_thresholdedBird;
     cv::Mat m_thresholdedWorld;
+    int m_pyramidScale{4};
+    cv::Mat m_coarseWorld; // PYRAMID only, pixel (x, y) is the frame's (x * m_pyramidScale, y * m_pyramidScale)
+    cv::Mat m_coarseRow; // PYRAMID only, a row's samples before they're thresholded
 #ifdef CALIBRATING_DETECTOR
     cv::Mat m_imgCombined;
+    std::vector<std::pair<int*, std::shared_ptr<const std::atomic<int>>>> m_calibrationControls; // threshold, slider
 #endif
     VideoFeed& m_display;
     const int m_lowSweepY; // sweep low to ensure we hit a pipe, not drive through a gap
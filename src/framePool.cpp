@@ -0,0 +1,85 @@
+#include "framePool.hpp"
+
+#include <cassert>
+
+struct PooledFrame::Buffer {
+    cv::Mat image;
+    std::atomic<int> references{0};
+};
+
+struct PooledFrame::Storage {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    std::vector<Buffer*> free; // capacity kept at buffers.size(), so releasing never allocates
+};
+
+PooledFrame::PooledFrame(std::shared_ptr<Storage> storage, Buffer* buffer)
+        : m_storage{std::move(storage)}, m_buffer{buffer} {
+    m_buffer->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+PooledFrame::PooledFrame(const PooledFrame& other) : m_storage{other.m_storage}, m_buffer{other.m_buffer} {
+    if (m_buffer) {
+        m_buffer->references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+PooledFrame::PooledFrame(PooledFrame&& other) noexcept
+        : m_storage{std::move(other.m_storage)}, m_buffer{other.m_buffer} {
+    other.m_buffer = nullptr;
+}
+
+PooledFrame& PooledFrame::operator=(PooledFrame other) noexcept {
+    std::swap(m_storage, other.m_storage);
+    std::swap(m_buffer, other.m_buffer);
+    return *this;
+}
+
+PooledFrame::~PooledFrame() {
+    reset();
+}
+
+cv::Mat& PooledFrame::image() const {
+    assert(m_buffer);
+    return m_buffer->image;
+}
+
+void PooledFrame::reset() {
+    if (!m_buffer) {
+        return;
+    }
+
+    // acq_rel so whatever the other owners did with the image happens before the pool hands it out again
+    if (m_buffer->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::unique_lock<std::mutex> _(m_storage->mutex);
+        m_storage->free.push_back(m_buffer);
+    }
+    m_buffer = nullptr;
+    m_storage.reset();
+}
+
+FramePool::FramePool() : m_storage{std::make_shared<PooledFrame::Storage>()} {}
+
+PooledFrame FramePool::acquire(int rows, int cols, int type) {
+    PooledFrame::Buffer* buffer;
+    {
+        std::unique_lock<std::mutex> _(m_storage->mutex);
+        if (m_storage->free.empty()) {
+            m_storage->buffers.push_back(std::make_unique<PooledFrame::Buffer>());
+            m_storage->free.reserve(m_storage->buffers.size());
+            buffer = m_storage->buffers.back().get();
+        } else {
+            buffer = m_storage->free.back();
+            m_storage->free.pop_back();
+        }
+    }
+
+    // no-op unless the shape changed
+    buffer->image.create(rows, cols, type);
+    return PooledFrame{m_storage, buffer};
+}
+
+size_t FramePool::size() const {
+    std::unique_lock<std::mutex> _(m_storage->mutex);
+    return m_storage->buffers.size();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/// Shared reference to a frame buffer borrowed from a FramePool, the buffer goes back to the pool once the last
+/// reference is gone (on whichever thread that happens). Copying only bumps reference counts, nothing is allocated.
+class PooledFrame {
+    struct Buffer;
+    struct Storage;
+    friend class FramePool;
+
+public:
+    PooledFrame() = default;
+    PooledFrame(const PooledFrame& other);
+    PooledFrame(PooledFrame&& other) noexcept;
+    PooledFrame& operator=(PooledFrame other) noexcept;
+    ~PooledFrame();
+
+    explicit operator bool() const {
+        return m_buffer != nullptr;
+    }
+
+    /// Shallow copies of the image don't keep the buffer from going back to the pool, hold on to this instead.
+    cv::Mat& image() const;
+
+    void reset();
+
+private:
+    PooledFrame(std::shared_ptr<Storage> storage, Buffer* buffer);
+
+    std::shared_ptr<Storage> m_storage; // keeps the buffers alive even if the pool itself is gone
+    Buffer* m_buffer{nullptr};
+};
+
+/**
+ * Reusable full-frame buffers, so that steady state capture doesn't allocate (and page fault) a fresh frame every
+ * iteration. Buffers are allocated by cv::Mat (64 byte aligned) the first time they're needed at a given size and kept
+ * from then on - the pool only grows if more frames are in flight at once than ever before.
+ */
+class FramePool {
+public:
+    FramePool();
+
+    /// Buffer of the given shape, contents undefined. Only call from one thread, frames can be released from any.
+    PooledFrame acquire(int rows, int cols, int type);
+
+    /// Total number of buffers, in use or not.
+    size_t size() const;
+
+private:
+    std::shared_ptr<PooledFrame::Storage> m_storage;
+};
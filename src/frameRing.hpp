@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+#include "units.hpp"
+
+struct CapturedFrame {
+    cv::Mat image;
+    // bracket the VideoSource::captureFrame() call, as Driver::drive() expects
+    TimePoint captureStart;
+    TimePoint captureEnd;
+};
+
+/**
+ * Lock-free hand-off of frames from a single producer (the capture thread) to a single consumer, where the consumer
+ * only ever wants the newest frame. Three slots go round between the producer (the one being filled), the consumer
+ * (the one being processed) and the newest published frame in the middle. Publishing over a frame the consumer never
+ * took drops it.
+ *
+ * Slots keep their buffers as they go round, so once every slot has seen a frame of the final size nothing allocates.
+ */
+class FrameRing {
+public:
+    /// Producer only - the slot to fill, owned by the producer until publish().
+    CapturedFrame& back() {
+        return m_slots[m_back];
+    }
+
+    /// Producer only - makes back() the newest frame and hands the producer another slot.
+    void publish() {
+        const uint8_t previous = m_newest.exchange(m_back | FRESH, std::memory_order_acq_rel);
+        if (previous & FRESH) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_back = previous & ~FRESH;
+    }
+
+    /// Consumer only - swaps the newest published frame into front(), if there's one the consumer hasn't seen yet.
+    /// The previous front() goes back to the producer, so it mustn't be used after this returns true.
+    bool takeNewest() {
+        if (!(m_newest.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+
+        // only the consumer clears FRESH, so it's still set even if the producer published again in the meantime
+        m_front = m_newest.exchange(m_front, std::memory_order_acq_rel) & ~FRESH;
+        return true;
+    }
+
+    /// Consumer only.
+    const CapturedFrame& front() const {
+        return m_slots[m_front];
+    }
+
+    /// Frames published but never taken by the consumer.
+    uint64_t dropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    // set on m_newest when it holds a frame the consumer hasn't taken yet
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<CapturedFrame, 3> m_slots;
+    uint8_t m_back{0};
+    uint8_t m_front{1};
+    std::atomic<uint8_t> m_newest{2};
+    std::atomic<uint64_t> m_dropped{0};
+};
@@ -0,0 +1,172 @@
+#include "gameSimulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+// the game area, in units of Distance - roughly the proportions of the phone screen
+static constexpr Distance WORLD_WIDTH{1.3f};
+static constexpr Distance PLAY_HEIGHT{1.8f}; // top of the screen to the ground
+static constexpr Distance GROUND_HEIGHT{0.3f}; // below the viewport, like the ground and the ads on the phone
+
+// the first pipe is already on screen when the game starts, so the Driver has something to fly through right away
+static constexpr Coordinate FIRST_PIPE_LEFT{0.9f};
+// shortest a pipe gets above or below its gap
+static constexpr Distance MIN_PIPE_LENGTH{0.15f};
+
+static constexpr TimePoint::duration SIMULATOR_STEP{1};
+
+// BGRA, each one well inside (or well outside) the FeatureDetector's HSV ranges
+static const cv::Scalar SKY_COLOUR{200, 190, 110, 255};
+static const cv::Scalar PIPE_COLOUR{40, 200, 147, 255};
+static const cv::Scalar GROUND_COLOUR{90, 120, 150, 255};
+static const cv::Scalar BIRD_COLOUR{0, 8, 230, 255};
+static const cv::Scalar BEAK_COLOUR{20, 170, 250, 255};
+
+GameSimulator::GameSimulator(unsigned seed, std::chrono::milliseconds tapDelay, int unitLength)
+        : m_tapDelay{tapDelay}, m_unitLength{unitLength}, m_random{seed}, m_birdY{PLAY_HEIGHT.val / 2} {
+    addPipe(FIRST_PIPE_LEFT);
+}
+
+VideoFeed::Viewport GameSimulator::viewport() const {
+    const int groundRow = static_cast<int>(PLAY_HEIGHT.val * m_unitLength);
+    const int cols = static_cast<int>(WORLD_WIDTH.val * m_unitLength);
+    return {cv::Point(0, groundRow), cv::Point(cols - 1, groundRow), groundRow, m_unitLength};
+}
+
+void GameSimulator::addPipe(Coordinate left) {
+    std::uniform_real_distribution<float> gapTop(MIN_PIPE_LENGTH.val,
+                                                 (PLAY_HEIGHT - MIN_PIPE_LENGTH - GAP_HEIGHT).val);
+    m_pipes.push_back({left, Coordinate{gapTop(m_random)}, false});
+}
+
+void GameSimulator::tap() {
+    if (m_crash != Crash::NONE) {
+        return;
+    }
+    m_pendingTaps.push_back(m_now + m_tapDelay);
+    ++m_taps;
+}
+
+void GameSimulator::advance(TimePoint::duration duration) {
+    const TimePoint until = m_now + duration;
+    while (m_now < until && m_crash == Crash::NONE) {
+        step();
+    }
+    m_now = until;
+}
+
+void GameSimulator::step() {
+    m_now += SIMULATOR_STEP;
+
+    while (!m_pendingTaps.empty() && m_pendingTaps.front() <= m_now) {
+        m_pendingTaps.pop_front();
+        m_birdSpeed = JUMP_SPEED;
+        m_started = true;
+    }
+    if (!m_started) {
+        return;
+    }
+
+    // exact under constant acceleration, which is all we have within a step (bar reaching terminal velocity)
+    const Speed newSpeed = std::min(m_birdSpeed + GRAVITY * SIMULATOR_STEP, TERMINAL_VELOCITY);
+    m_birdY += (m_birdSpeed + newSpeed) / 2 * SIMULATOR_STEP;
+    m_birdSpeed = newSpeed;
+
+    const Distance scrolled = HORIZONTAL_SPEED * SIMULATOR_STEP;
+    for (Pipe& pipe : m_pipes) {
+        pipe.left -= scrolled;
+        if (!pipe.passed && pipe.left + PIPE_WIDTH < BIRD_X_COORDINATE - BIRD_RADIUS) {
+            pipe.passed = true;
+            ++m_score;
+        }
+    }
+    if (m_pipes.front().left + PIPE_WIDTH < Coordinate{0}) {
+        m_pipes.pop_front();
+    }
+    if (m_pipes.back().left < Coordinate{WORLD_WIDTH.val}) {
+        // added just as it comes into view so that it's the same pipe however big the screen is
+        addPipe(m_pipes.back().left + PIPE_WIDTH + PIPE_SPACING);
+    }
+
+    m_crash = checkCrash();
+}
+
+// distance from a point to the nearest point of a rectangle, 0 if inside
+static float distanceToRect(float x, float y, float left, float top, float right, float bottom) {
+    const float dx = std::max({left - x, 0.f, x - right});
+    const float dy = std::max({top - y, 0.f, y - bottom});
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+std::pair<std::optional<Gap>, std::optional<Gap>> GameSimulator::gapsAheadOfBird() const {
+    std::pair<std::optional<Gap>, std::optional<Gap>> gaps;
+    for (const Pipe& pipe : m_pipes) {
+        // like the detector, which starts looking a bird's radius behind its centre
+        if (pipe.left + PIPE_WIDTH < BIRD_X_COORDINATE - BIRD_RADIUS || pipe.left >= Coordinate{WORLD_WIDTH.val}) {
+            continue;
+        }
+        const Coordinate right = pipe.left + PIPE_WIDTH;
+        const Coordinate bottom = pipe.gapTop + GAP_HEIGHT;
+        const Gap gap{{pipe.left, bottom}, {right, bottom}, {pipe.left, pipe.gapTop}, {right, pipe.gapTop}};
+        if (!gaps.first) {
+            gaps.first = gap;
+        } else {
+            gaps.second = gap;
+            break;
+        }
+    }
+    return gaps;
+}
+
+GameSimulator::Crash GameSimulator::checkCrash() const {
+    if (m_birdY + BIRD_RADIUS >= Coordinate{PLAY_HEIGHT.val}) {
+        return Crash::GROUND;
+    }
+
+    const float x = BIRD_X_COORDINATE.val;
+    const float y = m_birdY.val;
+    for (const Pipe& pipe : m_pipes) {
+        const float left = pipe.left.val;
+        const float right = (pipe.left + PIPE_WIDTH).val;
+        const float gapTop = pipe.gapTop.val;
+        const float gapBottom = (pipe.gapTop + GAP_HEIGHT).val;
+        // the upper pipe goes on above the screen, flying over it doesn't help
+        if (distanceToRect(x, y, left, std::numeric_limits<float>::lowest(), right, gapTop) < BIRD_RADIUS.val
+                || distanceToRect(x, y, left, gapBottom, right, PLAY_HEIGHT.val) < BIRD_RADIUS.val) {
+            return Crash::PIPE;
+        }
+    }
+
+    return Crash::NONE;
+}
+
+const cv::Mat& GameSimulator::captureFrame() {
+    const auto toPixels = [this](float units) {
+        return static_cast<int>(units * m_unitLength);
+    };
+
+    const int groundRow = toPixels(PLAY_HEIGHT.val);
+    m_frame.create(toPixels((PLAY_HEIGHT + GROUND_HEIGHT).val), toPixels(WORLD_WIDTH.val), CV_8UC4);
+    m_frame.setTo(SKY_COLOUR);
+
+    for (const Pipe& pipe : m_pipes) {
+        const int left = toPixels(pipe.left.val);
+        const int right = toPixels((pipe.left + PIPE_WIDTH).val) - 1;
+        cv::rectangle(m_frame, cv::Point(left, 0), cv::Point(right, toPixels(pipe.gapTop.val) - 1), PIPE_COLOUR,
+                      cv::FILLED);
+        cv::rectangle(m_frame, cv::Point(left, toPixels((pipe.gapTop + GAP_HEIGHT).val)),
+                      cv::Point(right, groundRow - 1), PIPE_COLOUR, cv::FILLED);
+    }
+    cv::rectangle(m_frame, cv::Point(0, groundRow), cv::Point(m_frame.cols - 1, m_frame.rows - 1), GROUND_COLOUR,
+                  cv::FILLED);
+
+    const cv::Point bird(toPixels(BIRD_X_COORDINATE.val), toPixels(m_birdY.val));
+    const int radius = toPixels(BIRD_RADIUS.val);
+    cv::circle(m_frame, bird, radius, BIRD_COLOUR, cv::FILLED);
+    cv::circle(m_frame, cv::Point(bird.x + radius * 4 / 5, bird.y), radius / 3, BEAK_COLOUR, cv::FILLED);
+
+    return m_frame;
+}
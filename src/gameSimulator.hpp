@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <random>
+#include <utility>
+
+#include <opencv2/core/core.hpp>
+
+#include "arm.hpp"
+#include "constants.hpp"
+#include "display.hpp"
+#include "gap.hpp"
+#include "units.hpp"
+#include "VideoSource.hpp"
+
+/**
+ * The game itself, and the arm tapping it, for playing closed-loop games without the emulator or any hardware. The bird
+ * and the pipes move by the constants in constants.hpp, taps land tapDelay() after tap() and frames are drawn in
+ * colours the FeatureDetector's thresholds pick up.
+ *
+ * Time only moves on advance(), so a game runs as fast as whatever is playing it - give now() to the Driver as its
+ * clock. Gaps are placed by a seeded generator, the same seed and the same taps make the same game.
+ *
+ * Like the real game, nothing moves until the first tap lands.
+ */
+class GameSimulator : public VideoSource, public Arm {
+public:
+    enum class Crash {
+        NONE,
+        PIPE,
+        GROUND
+    };
+
+    /// @param unitLength pixels per unit of Distance in the rendered frames
+    explicit GameSimulator(unsigned seed = 0, std::chrono::milliseconds tapDelay = SIMULATED_ARM_TAP_DELAY,
+                           int unitLength = 300);
+
+    /// Where the game is within the frames, for VideoFeed::setViewport().
+    VideoFeed::Viewport viewport() const;
+
+    TimePoint now() const {
+        return m_now;
+    }
+
+    /// Moves the game on, landing any taps that are due on the way. The game stops moving once the bird has crashed.
+    void advance(TimePoint::duration duration);
+
+    Crash crash() const {
+        return m_crash;
+    }
+
+    /// Pipes the bird has got past.
+    int score() const {
+        return m_score;
+    }
+
+    int taps() const {
+        return m_taps;
+    }
+
+    Position birdPosition() const {
+        return {BIRD_X_COORDINATE, m_birdY};
+    }
+
+    /// What the FeatureDetector should find ahead of the bird: the first gap it hasn't got past and the one after, as
+    /// long as they're on screen.
+    std::pair<std::optional<Gap>, std::optional<Gap>> gapsAheadOfBird() const;
+
+    /// Renders the game as it is at now().
+    const cv::Mat& captureFrame() override;
+
+    double capturePoint() const override {
+        return CAPTURE_POINT;
+    }
+
+    void tap() override;
+
+    std::chrono::milliseconds liftDelay() const override {
+        return SIMULATED_ARM_LIFT_DELAY;
+    }
+
+    std::chrono::milliseconds tapDelay() const override {
+        return m_tapDelay;
+    }
+
+private:
+    struct Pipe {
+        Coordinate left;
+        Coordinate gapTop;
+        bool passed;
+    };
+
+    /// One SIMULATOR_STEP of physics.
+    void step();
+    void addPipe(Coordinate left);
+    Crash checkCrash() const;
+
+    const std::chrono::milliseconds m_tapDelay;
+    const int m_unitLength;
+    std::mt19937 m_random;
+
+    TimePoint m_now{};
+    std::deque<TimePoint> m_pendingTaps; // when they land, in order
+    bool m_started{false};
+
+    Coordinate m_birdY;
+    Speed m_birdSpeed{{0}};
+    std::deque<Pipe> m_pipes; // left to right
+
+    Crash m_crash{Crash::NONE};
+    int m_score{0};
+    int m_taps{0};
+
+    cv::Mat m_frame;
+};
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "constants.hpp"
+#include "display.hpp"
+#include "driver.hpp"
+#include "gameSimulator.hpp"
+#include "policyTable.hpp"
+#include "threadPool.hpp"
+#include "toolOptions.hpp"
+
+/*
+ * Runs the Driver's search from every state of a grid (see policyTable.hpp) on all cores and writes the decisions out
+ * as a policy table, for Driver::setPolicyTable(). The geometry (ground, right boundary) is the GameSimulator's, or
+ * with --saved-boundaries the one last set by clicking in FlappyBird (its boundaries file, in the working directory) -
+ * the live game only uses tables computed for its own geometry. The search settings have to match the ones the table
+ * will be used with.
+ *
+ * The grid is the product of all the axes, so it grows quickly with finer steps - at the defaults, it's tens of
+ * millions of searches.
+ *
+ * usage: generatePolicy output.policy [--arm physical|simulated] [--threads N] [--position-step U]
+ *                       [--speed-step U] [--tap-cells N] [--swept] [--adaptive] [--quantum-ms N]
+ *                       [--saved-boundaries]
+ */
+
+struct Options {
+    std::string output;
+    std::chrono::milliseconds tapDelay{SIMULATED_ARM_TAP_DELAY};
+    std::chrono::milliseconds liftDelay{SIMULATED_ARM_LIFT_DELAY};
+    unsigned threads{std::thread::hardware_concurrency()};
+    float positionStep{0.05f};
+    float speedStep{0.0005f};
+    uint32_t tapCells{4};
+    bool swept{false};
+    bool adaptive{false};
+    TimePoint::duration quantum{SIMULATION_TIME_QUANTUM};
+    bool savedBoundaries{false};
+};
+
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "--arm") {
+            const std::string arm = optionValue(argc, argv, i);
+            if (arm == "physical") {
+                options.tapDelay = PHYSICAL_ARM_TAP_DELAY;
+                options.liftDelay = PHYSICAL_ARM_LIFT_DELAY;
+            } else if (arm != "simulated") {
+                throw std::invalid_argument("unknown arm: " + arm);
+            }
+        } else if (arg == "--threads") {
+            options.threads = static_cast<unsigned>(std::stoul(optionValue(argc, argv, i)));
+        } else if (arg == "--position-step") {
+            options.positionStep = std::stof(optionValue(argc, argv, i));
+        } else if (arg == "--speed-step") {
+            options.speedStep = std::stof(optionValue(argc, argv, i));
+        } else if (arg == "--tap-cells") {
+            options.tapCells = static_cast<uint32_t>(std::stoul(optionValue(argc, argv, i)));
+        } else if (arg == "--swept") {
+            options.swept = true;
+        } else if (arg == "--adaptive") {
+            options.adaptive = true;
+        } else if (arg == "--quantum-ms") {
+            options.quantum = TimePoint::duration{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--saved-boundaries") {
+            options.savedBoundaries = true;
+        } else if (options.output.empty() && arg.rfind("--", 0) != 0) {
+            options.output = arg;
+        } else {
+            throw std::invalid_argument("unknown option: " + arg);
+        }
+    }
+
+    if (options.output.empty()) {
+        throw std::invalid_argument("no output file given");
+    }
+    if (!(options.positionStep > 0) || !(options.speedStep > 0) || options.tapCells < 2 || options.threads == 0) {
+        throw std::invalid_argument("the grid needs positive steps and at least two tap cells");
+    }
+    return options;
+}
+
+/// Stands in for the arm, the search only needs its delays.
+class FixedDelayArm : public Arm {
+public:
+    FixedDelayArm(std::chrono::milliseconds tapDelay, std::chrono::milliseconds liftDelay)
+            : m_tapDelay{tapDelay}, m_liftDelay{liftDelay} {}
+
+    void tap() override {}
+
+    std::chrono::milliseconds liftDelay() const override {
+        return m_liftDelay;
+    }
+
+    std::chrono::milliseconds tapDelay() const override {
+        return m_tapDelay;
+    }
+
+private:
+    const std::chrono::milliseconds m_tapDelay;
+    const std::chrono::milliseconds m_liftDelay;
+};
+
+// cells from `min` to `max` inclusive (give or take a step)
+static policy_file::Axis axis(float min, float max, float step) {
+    return {min, step, static_cast<uint32_t>(std::floor((max - min) / step)) + 1, 0};
+}
+
+static float centre(const policy_file::Axis& axis, uint32_t cell) {
+    return axis.min + cell * axis.step;
+}
+
+// how many grid states each task searches, with its own driver
+static constexpr size_t STATES_PER_TASK = 4096;
+
+int main(int argc, char** argv) {
+    try {
+        const Options options = parseOptions(argc, argv);
+        if (options.quantum <= options.tapDelay) {
+            throw std::invalid_argument("--quantum-ms must be more than the arm's tap delay");
+        }
+
+        // only for the geometry, nothing is played
+        GameSimulator geometrySource;
+        VideoFeed geometry(geometrySource, true);
+        if (options.savedBoundaries) {
+            geometry.loadBoundaries();
+            if (!geometry.boundariesKnown()) {
+                throw std::runtime_error("no saved boundaries, set them by clicking in FlappyBird first");
+            }
+        } else {
+            geometry.setViewport(geometrySource.viewport());
+        }
+        const VideoFeed::Viewport viewport = geometry.viewport();
+        const Coordinate groundLevel = geometry.pixelYToPosition(geometry.getGroundLevel());
+        const Distance boundaryAhead = geometry.pixelXToPosition(geometry.getRightBoundary()) - BIRD_X_COORDINATE;
+
+        using namespace policy_file;
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.searchFlags = searchFlags(options.swept, options.adaptive);
+        header.tapDelay = static_cast<int32_t>(options.tapDelay.count());
+        header.liftDelay = static_cast<int32_t>(options.liftDelay.count());
+        header.searchQuantum = static_cast<int32_t>(options.quantum.count());
+        header.groundLevel = groundLevel.val;
+        header.boundaryAhead = boundaryAhead.val;
+        header.gapHeight = GAP_HEIGHT.val;
+        header.pipeWidth = PIPE_WIDTH.val;
+        header.pipeSpacing = PIPE_SPACING.val;
+
+        const float lowestGapTop = (groundLevel - GAP_HEIGHT).val;
+        header.axes[BIRD_Y] = axis(0, (groundLevel - BIRD_RADIUS - GROUND_SAFETY_BUFFER).val, options.positionStep);
+        header.axes[VERTICAL_SPEED] = axis(JUMP_SPEED.val.val, TERMINAL_VELOCITY.val.val, options.speedStep);
+        // the last cell is the clamped "ready to tap" value, exactly
+        const float cooldown = static_cast<float>(options.liftDelay.count() + 1);
+        header.axes[SINCE_LAST_TAP] = {0, cooldown / (options.tapCells - 1), options.tapCells, 0};
+        header.axes[GAP_X] = axis(-(PIPE_WIDTH + BIRD_RADIUS).val, boundaryAhead.val, options.positionStep);
+        header.axes[GAP_TOP] = axis(0, lowestGapTop, options.positionStep);
+        header.axes[NEXT_GAP_TOP] = header.axes[GAP_TOP];
+
+        const size_t states = entryCount(header);
+        std::cout << "searching " << states << " states on " << options.threads << " threads" << std::endl;
+        std::vector<Entry> entries(states);
+
+        ThreadPool pool(options.threads);
+        std::atomic<size_t> done{0};
+        std::mutex progress;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const size_t tasks = (states + STATES_PER_TASK - 1) / STATES_PER_TASK;
+        pool.parallelFor(tasks, [&](size_t task) {
+            // everything the search touches is per task, the table's entries are only written once each
+            GameSimulator source;
+            VideoFeed display(source, true);
+            display.setViewport(viewport);
+            FixedDelayArm arm(options.tapDelay, options.liftDelay);
+            Driver driver{arm, display};
+            driver.setSweptCollision(options.swept);
+            driver.setSearchQuantum(options.quantum);
+            driver.setAdaptiveStep(options.adaptive);
+
+            const size_t end = std::min(states, (task + 1) * STATES_PER_TASK);
+            for (size_t i = task * STATES_PER_TASK; i < end; ++i) {
+                const Cells cell = cells(header, i);
+                const Motion motion{{BIRD_X_COORDINATE, Coordinate{centre(header.axes[BIRD_Y], cell[BIRD_Y])}},
+                                    Speed{Distance{centre(header.axes[VERTICAL_SPEED], cell[VERTICAL_SPEED])}}};
+                const TimePoint::duration sinceLastTap{
+                        std::lround(centre(header.axes[SINCE_LAST_TAP], cell[SINCE_LAST_TAP]))};
+
+                const auto gapAt = [](Coordinate left, Coordinate top) {
+                    return Gap{{left, top + GAP_HEIGHT}, {left + PIPE_WIDTH, top + GAP_HEIGHT},
+                               {left, top}, {left + PIPE_WIDTH, top}};
+                };
+                std::pair<std::optional<Gap>, std::optional<Gap>> gaps;
+                gaps.first = gapAt(BIRD_X_COORDINATE + Distance{centre(header.axes[GAP_X], cell[GAP_X])},
+                                   Coordinate{centre(header.axes[GAP_TOP], cell[GAP_TOP])});
+                if (cell[NEXT_GAP_TOP] < header.axes[NEXT_GAP_TOP].count) {
+                    gaps.second = gapAt(gaps.first->lowerRight.x + PIPE_SPACING,
+                                        Coordinate{centre(header.axes[NEXT_GAP_TOP], cell[NEXT_GAP_TOP])});
+                }
+
+                const Action action = driver.bestAction(motion, sinceLastTap, gaps);
+                const float clearance = action == Action::NONE ? 0.f : driver.lastSearch().clearance.val;
+                entries[i] = {static_cast<uint16_t>(std::min(std::lround(clearance / CLEARANCE_UNIT), 65535l)),
+                              static_cast<uint8_t>(action), 0};
+            }
+
+            const size_t before = done.fetch_add(end - task * STATES_PER_TASK);
+            if ((before * 100 / states) != ((before + end - task * STATES_PER_TASK) * 100 / states)) {
+                std::unique_lock<std::mutex> _(progress);
+                std::cout << (before + end - task * STATES_PER_TASK) * 100 / states << "%" << std::endl;
+            }
+        });
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        write(options.output, header, entries);
+        std::cout << "wrote " << options.output << " in " << elapsed.count() << "s" << std::endl;
+    } catch (std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
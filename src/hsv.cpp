@@ -0,0 +1,118 @@
+#include "hsv.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HSV_HAS_AVX2_KERNELS
+#endif
+
+namespace hsv {
+
+namespace {
+
+constexpr uint8_t SET = 255;
+constexpr uint8_t CLEAR = 0;
+
+void thresholdRowScalar(const uint8_t* pixels, int channels, int begin, int end, const Thresholds& thresholds,
+                        uint8_t* worldMask, uint8_t* birdMask) {
+    for (int i = begin; i < end; ++i) {
+        const uint8_t* bgr = pixels + i * channels;
+        const Pixel pixel = fromBgr(bgr[0], bgr[1], bgr[2]);
+        worldMask[i] = inRange(pixel, thresholds.world) ? SET : CLEAR;
+        if (birdMask) {
+            birdMask[i] = inRange(pixel, thresholds.bird) || inRange(pixel, thresholds.beak) ? SET : CLEAR;
+        }
+    }
+}
+
+#ifdef HSV_HAS_AVX2_KERNELS
+/// Bit i of the index set -> byte i of the entry 0xFF, so a movemask can be stored as 8 mask bytes.
+constexpr std::array<uint64_t, 256> makeBitsToBytes() {
+    std::array<uint64_t, 256> table{};
+    for (int bits = 0; bits < 256; ++bits) {
+        for (int i = 0; i < 8; ++i) {
+            if (bits & (1 << i)) {
+                table[bits] |= uint64_t{0xFF} << (8 * i);
+            }
+        }
+    }
+    return table;
+}
+
+constexpr std::array<uint64_t, 256> BITS_TO_BYTES = makeBitsToBytes();
+
+/// One bit per lane, set where the pixel is within the range.
+__attribute__((target("avx2")))
+int inRangeBits(__m256i h, __m256i s, __m256i v, const Range& range) {
+    __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(range.lowH), h),
+                                      _mm256_cmpgt_epi32(h, _mm256_set1_epi32(range.highH)));
+    outside = _mm256_or_si256(outside, _mm256_cmpgt_epi32(_mm256_set1_epi32(range.lowS), s));
+    outside = _mm256_or_si256(outside, _mm256_cmpgt_epi32(s, _mm256_set1_epi32(range.highS)));
+    outside = _mm256_or_si256(outside, _mm256_cmpgt_epi32(_mm256_set1_epi32(range.lowV), v));
+    outside = _mm256_or_si256(outside, _mm256_cmpgt_epi32(v, _mm256_set1_epi32(range.highV)));
+    return ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+}
+
+/// 8 BGRA pixels at a time, one per 32 bit lane - same arithmetic as fromBgr().
+__attribute__((target("avx2")))
+void thresholdRowAvx2(const uint8_t* pixels, int count, const Thresholds& thresholds,
+                      uint8_t* worldMask, uint8_t* birdMask) {
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i half = _mm256_set1_epi32(1 << (SHIFT - 1));
+    const __m256i hueRange = _mm256_set1_epi32(180);
+    const __m256i zero = _mm256_setzero_si256();
+    const int* saturationDivision = SATURATION_DIVISION.data();
+    const int* hueDivision = HUE_DIVISION.data();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i bgra = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + 4 * i));
+        const __m256i b = _mm256_and_si256(bgra, byteMask);
+        const __m256i g = _mm256_and_si256(_mm256_srli_epi32(bgra, 8), byteMask);
+        const __m256i r = _mm256_and_si256(_mm256_srli_epi32(bgra, 16), byteMask);
+
+        const __m256i v = _mm256_max_epi32(_mm256_max_epi32(b, g), r);
+        const __m256i diff = _mm256_sub_epi32(v, _mm256_min_epi32(_mm256_min_epi32(b, g), r));
+
+        const __m256i s = _mm256_srli_epi32(
+                _mm256_add_epi32(_mm256_mullo_epi32(diff, _mm256_i32gather_epi32(saturationDivision, v, 4)), half),
+                SHIFT);
+
+        const __m256i fromRed = _mm256_sub_epi32(g, b);
+        const __m256i fromGreen = _mm256_add_epi32(_mm256_sub_epi32(b, r), _mm256_slli_epi32(diff, 1));
+        const __m256i fromBlue = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_slli_epi32(diff, 2));
+        __m256i h = _mm256_blendv_epi8(_mm256_blendv_epi8(fromBlue, fromGreen, _mm256_cmpeq_epi32(v, g)),
+                                       fromRed, _mm256_cmpeq_epi32(v, r));
+        h = _mm256_srai_epi32(
+                _mm256_add_epi32(_mm256_mullo_epi32(h, _mm256_i32gather_epi32(hueDivision, diff, 4)), half), SHIFT);
+        h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(zero, h), hueRange));
+
+        std::memcpy(worldMask + i, &BITS_TO_BYTES[inRangeBits(h, s, v, thresholds.world)], 8);
+        if (birdMask) {
+            const int birdBits = inRangeBits(h, s, v, thresholds.bird) | inRangeBits(h, s, v, thresholds.beak);
+            std::memcpy(birdMask + i, &BITS_TO_BYTES[birdBits], 8);
+        }
+    }
+
+    thresholdRowScalar(pixels, 4, i, count, thresholds, worldMask, birdMask);
+}
+
+const bool HAS_AVX2 = __builtin_cpu_supports("avx2");
+#endif // HSV_HAS_AVX2_KERNELS
+
+} // namespace
+
+void thresholdRow(const uint8_t* pixels, int channels, int count, const Thresholds& thresholds,
+                  uint8_t* worldMask, uint8_t* birdMask) {
+#ifdef HSV_HAS_AVX2_KERNELS
+    // 3 channel pixels don't line up with the lanes, the screen captures are BGRA anyway
+    if (HAS_AVX2 && channels == 4) {
+        thresholdRowAvx2(pixels, count, thresholds, worldMask, birdMask);
+        return;
+    }
+#endif
+    thresholdRowScalar(pixels, channels, 0, count, thresholds, worldMask, birdMask);
+}
+
+} // namespace hsv
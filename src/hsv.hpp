@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+/*
+ * Equivalent of cv::cvtColor(..., COLOR_BGR2HSV) followed by cv::inRange(), without materialising the HSV image - per
+ * pixel for when we only need a handful of them, or fused over whole rows. Uses the same fixed point arithmetic as
+ * OpenCV's 8-bit conversion so the results match exactly (H is 0-180, S and V 0-255).
+ */
+
+namespace hsv {
+
+struct Range {
+    int lowH, highH;
+    int lowS, highS;
+    int lowV, highV;
+};
+
+struct Pixel {
+    int h, s, v;
+};
+
+constexpr int SHIFT = 12;
+
+// 255 / v and 180 / (6 * diff) in SHIFT fixed point, rounded (never a tie for 8-bit inputs)
+constexpr std::array<int, 256> makeDivisionTable(int numerator) {
+    std::array<int, 256> table{};
+    for (int i = 1; i < 256; ++i) {
+        table[i] = ((numerator << (SHIFT + 1)) + i) / (2 * i);
+    }
+    return table;
+}
+
+inline constexpr std::array<int, 256> SATURATION_DIVISION = makeDivisionTable(255);
+inline constexpr std::array<int, 256> HUE_DIVISION = makeDivisionTable(30); // 180 / 6
+
+inline Pixel fromBgr(int b, int g, int r) {
+    const int v = std::max(std::max(b, g), r);
+    const int diff = v - std::min(std::min(b, g), r);
+
+    const int s = (diff * SATURATION_DIVISION[v] + (1 << (SHIFT - 1))) >> SHIFT;
+
+    int h;
+    if (v == r) {
+        h = g - b;
+    } else if (v == g) {
+        h = b - r + 2 * diff;
+    } else {
+        h = r - g + 4 * diff;
+    }
+    h = (h * HUE_DIVISION[diff] + (1 << (SHIFT - 1))) >> SHIFT;
+    if (h < 0) {
+        h += 180;
+    }
+
+    return {h, s, v};
+}
+
+inline bool inRange(const Pixel& pixel, const Range& range) {
+    return range.lowH <= pixel.h && pixel.h <= range.highH
+           && range.lowS <= pixel.s && pixel.s <= range.highS
+           && range.lowV <= pixel.v && pixel.v <= range.highV;
+}
+
+/// The ranges FeatureDetector thresholds each frame against.
+struct Thresholds {
+    Range world;
+    Range bird;
+    Range beak;
+};
+
+/**
+ * Classifies `count` pixels of a BGR or BGRA row in a single pass, setting worldMask[i] to 255 if pixel i is in the
+ * world range and 0 otherwise. Likewise for birdMask (bird or beak range), unless it's null.
+ */
+void thresholdRow(const uint8_t* pixels, int channels, int count, const Thresholds& thresholds,
+                  uint8_t* worldMask, uint8_t* birdMask);
+
+} // namespace hsv
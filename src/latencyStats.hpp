@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// Collects durations of a repeated stage and reports their distribution.
+class LatencyStats {
+public:
+    explicit LatencyStats(std::string name) : m_name{std::move(name)} {}
+
+    void add(std::chrono::nanoseconds sample) {
+        m_samples.push_back(sample);
+    }
+
+    /// Takes in all of `other`'s samples, e.g. to combine stats collected on separate threads.
+    void merge(const LatencyStats& other) {
+        m_samples.insert(m_samples.end(), other.m_samples.begin(), other.m_samples.end());
+    }
+
+    size_t count() const {
+        return m_samples.size();
+    }
+
+    std::chrono::nanoseconds total() const {
+        std::chrono::nanoseconds sum{0};
+        for (std::chrono::nanoseconds sample : m_samples) {
+            sum += sample;
+        }
+        return sum;
+    }
+
+    /// Nearest-rank percentile, p in [0, 100]. Sorts the samples.
+    std::chrono::nanoseconds percentile(double p) {
+        if (m_samples.empty()) {
+            return std::chrono::nanoseconds{0};
+        }
+        std::sort(m_samples.begin(), m_samples.end());
+        const size_t rank = static_cast<size_t>(p / 100 * (m_samples.size() - 1) + 0.5);
+        return m_samples[rank];
+    }
+
+    /// One row of a table of stages, in microseconds.
+    void report(std::ostream& out) {
+        const auto us = [](std::chrono::nanoseconds duration) { return duration.count() / 1000.0; };
+        out << std::left << std::setw(16) << m_name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(8) << count()
+            << std::setw(10) << us(percentile(50))
+            << std::setw(10) << us(percentile(90))
+            << std::setw(10) << us(percentile(99))
+            << std::setw(10) << us(percentile(100))
+            << std::setw(10) << (count() ? us(total()) / count() : 0.0) << "\n";
+    }
+
+    static void reportHeader(std::ostream& out) {
+        out << std::left << std::setw(16) << "stage (us)" << std::right << std::setw(8) << "count" << std::setw(10)
+            << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(10)
+            << "mean" << "\n";
+    }
+
+private:
+    std::string m_name;
+    std::vector<std::chrono::nanoseconds> m_samples;
+};
@@ -1,18 +1,56 @@
+#include <atomic>
+#include <csignal>
 #include <iostream>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
 
+#include "captureThread.hpp"
 #include "physicalArm.hpp"
 #include "driver.hpp"
 #include "display.hpp"
 #include "Recording.hpp"
 #include "WebCam.hpp"
 #include "ScreenCapture.hpp"
+#include "ShmScreenCapture.hpp"
 #include "simulatedArm.hpp"
 #include "constants.hpp"
+#include "tracer.hpp"
+
+static std::atomic<bool> interrupted{false};
 
 int main(int argc, char** argv) {
+    // --pipelined: capture on a separate thread, overlapping with detection and planning
+    // --trace: record stage timings from the start ('t' toggles it at runtime), dumped to TRACE_FILE
+    // --policy table.policy: look decisions up in a table from generatePolicy, searching only where it has none
+    // --headless: no window, with the boundaries from the last windowed run; no keys either, Ctrl-C stops (like Esc)
+    bool pipelined = false;
+    bool headless = false;
+    std::optional<std::string> policyFile;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--pipelined") {
+            pipelined = true;
+        } else if (std::string(argv[i]) == "--trace") {
+            tracer::setEnabled(true);
+        } else if (std::string(argv[i]) == "--policy") {
+            if (i + 1 >= argc) {
+                std::cerr << "usage: --policy needs a table file (from generatePolicy)\n";
+                exit(EXIT_FAILURE);
+            }
+            policyFile = argv[++i];
+        } else if (std::string(argv[i]) == "--headless") {
+            headless = true;
+        }
+    }
+    const std::string TRACE_FILE = "trace.json";
+    tracer::setThreadName("main");
+
+    if (pipelined) {
+        // the capture thread and the arm share the X11 connection
+        XInitThreads();
+    }
+
     Recording recording;
     Display *X11display = XOpenDisplay(nullptr);
 
@@ -22,10 +60,25 @@ int main(int argc, char** argv) {
     }
 
     RAIICloser closer([X11display](){ XCloseDisplay(X11display);});
-    ScreenCapture screen(X11display);
+    // shared memory capture avoids pushing every frame through the X11 socket, but only works with a local server
+    std::unique_ptr<VideoSource> screen;
+    try {
+        screen = std::make_unique<ShmScreenCapture>(X11display);
+    } catch (std::runtime_error& ex) {
+        std::cerr << "Falling back to XGetImage capture: " << ex.what() << "\n";
+        screen = std::make_unique<ScreenCapture>(X11display);
+    }
     SimulatedArm arm(997, 1545, X11display);
 
-    VideoFeed display(screen);
+    VideoFeed display(*screen, headless);
+    if (headless) {
+        display.loadBoundaries();
+        if (!display.boundariesKnown()) {
+            std::cerr << "--headless needs the boundaries saved by a windowed run\n";
+            exit(EXIT_FAILURE);
+        }
+        std::signal(SIGINT, [](int) { interrupted = true; });
+    }
 
     // VideoFeed display(recording);
     // recording.load(display);
@@ -35,11 +88,36 @@ int main(int argc, char** argv) {
 
     // PhysicalArm arm(true);
     Driver driver{arm, display};
+    // a late decision is acted on a stale frame, better to plan a shorter horizon
+    driver.setPlanningBudget(PLANNING_TIME_BUDGET);
+    if (policyFile) {
+        try {
+            const std::shared_ptr<const PolicyTable> table = std::make_shared<const PolicyTable>(policyFile.value());
+            driver.setPolicyTable(table);
+            if (display.boundariesKnown()) {
+                table->warnUnlessMatches(display.pixelYToPosition(display.getGroundLevel()),
+                                         display.pixelXToPosition(display.getRightBoundary()) - BIRD_X_COORDINATE);
+            }
+        } catch (std::exception& ex) {
+            std::cerr << "Can't use the policy table: " << ex.what() << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
     bool humanDriving = false;
 
     cv::Mat thresholdedBird;
     cv::Mat thresholdedWorld;
     FeatureDetector detector{display};
+    // only calibration needs the whole frame thresholded
+    detector.setMode(FeatureDetector::Mode::LAZY);
+    detector.setGapTracking(true);
+    detector.setBirdTracking(true);
+
+    // all captures go through this when pipelined, the source mustn't be touched from this thread
+    std::unique_ptr<CaptureThread> capture;
+    if (pipelined) {
+        capture = std::make_unique<CaptureThread>(*screen);
+    }
 
     try {
         bool recordFeed = false; // TODO use Recording state
@@ -51,22 +129,42 @@ int main(int argc, char** argv) {
         auto prevT = TimePoint().time_since_epoch().count(); // for calibration
         while (true) {
             if (!display.boundariesKnown()) {
-                cv::waitKey(1);
+                display.pollKey(1ms); // the clicks setting them
                 display.show();
                 continue;
             }
 
             TimePoint frameStart = toTime(std::chrono::system_clock::now());
 
-            TimePoint captureStart = toTime(std::chrono::system_clock::now());
-            display.captureFrame(); // 2-6ms on X11 (emulator)
-            TimePoint captureEnd = toTime(std::chrono::system_clock::now());
+            TimePoint captureStart;
+            TimePoint captureEnd;
+            if (capture) {
+                TRACE_SPAN("wait for frame");
+                const CapturedFrame& frame = capture->nextFrame();
+                display.setCurrentFrame(frame.image);
+                captureStart = frame.captureStart;
+                captureEnd = frame.captureEnd;
+            } else {
+                TRACE_SPAN("capture");
+                captureStart = toTime(std::chrono::system_clock::now());
+                display.captureFrame(); // 2-6ms on X11 (emulator)
+                captureEnd = toTime(std::chrono::system_clock::now());
+            }
 
             std::optional<Position> birdPos;
             if (recordFeed) {
-                recording.record(display.getCurrentFrame());
+                TRACE_SPAN("record");
+                recording.record(display);
             } else {
-                detector.process(display.getCurrentFrame());
+                {
+                    TRACE_SPAN("detect");
+                    // played back frames weren't captured now, their gaps can't be tracked by the wall clock
+                    std::optional<TimePoint> frameTime;
+                    if (recording.getState() != Recording::PLAYBACK) {
+                        frameTime = captureStart;
+                    }
+                    detector.process(display.getCurrentFrame(), frameTime);
+                }
 
                 // for calibrating motion constants
                 if (recording.getState() == Recording::PLAYBACK) {
@@ -99,38 +197,56 @@ int main(int argc, char** argv) {
                 }
 
                 if (!recordFeed) {
-                    birdPos = detector.findBird();
+                    {
+                        TRACE_SPAN("findBird");
+                        birdPos = detector.findBird();
+                    }
                     std::pair<std::optional<Gap>, std::optional<Gap>> gaps;
                     if (birdPos) {
+                        // before marking the frame, the lazy detector reads it as it goes
+                        {
+                            TRACE_SPAN("findGapsAheadOf");
+                            gaps = detector.findGapsAheadOf(birdPos.value());
+                        }
+                        assert(!gaps.second || gaps.first); // detecting the right but not the left gap would be unexpected
+
                         if (!recordFeed) {
                             // don't mark anything during recording, it will confuse the detector working off the recording
                             display.circle(Position{birdPos.value().x, Coordinate{birdPos.value().y.val}},
                                            BIRD_RADIUS, CV_BLUE);
                         }
-
-                        gaps = detector.findGapsAheadOf(birdPos.value());
-                        assert(!gaps.second || gaps.first); // detecting the right but not the left gap would be unexpected
                     }
 
                     if (!humanDriving) {
+                        TRACE_SPAN("drive");
                         driver.drive(birdPos, gaps, captureStart, captureEnd);
                     }
                 }
             }
 
-            display.show();
-
-            const char key = cv::waitKey(1);
+            char key;
+            {
+                TRACE_SPAN("display");
+                display.show();
+                key = display.pollKey();
+            }
+            if (interrupted) {
+                key = 27;
+            }
             if (key == 27) {
                 if (recordFeed) {
                     std::cout << "Saving feed" << std::endl;
-                    recording.save(display);
+                    recording.save();
+                }
+                if (tracer::enabled()) {
+                    std::cout << "Writing trace to " << TRACE_FILE << std::endl;
+                    tracer::dump(TRACE_FILE);
                 }
                 std::cout << "Exiting" << std::endl;
                 break;
             } else if (key == 32 && humanDriving) { // space
                 // if (recording.getState() != Recording::PLAYBACK) {
-                //     recording.startRecording();
+                //     recording.startRecording(display);
                 //     recordFeed = true;
                 // }
                 arm.tap();
@@ -142,18 +258,42 @@ int main(int argc, char** argv) {
                 } else {
                     std::cout << "Switch to automatic FAILED - can't find the bird" << std::endl;
                 }
+            } else if (key == 'p') {
+                switch (driver.plannerEngine()) {
+                    case Driver::PlannerEngine::RECURSIVE:
+                        std::cout << "Switching to batch planner" << std::endl;
+                        driver.setPlannerEngine(Driver::PlannerEngine::BATCH);
+                        break;
+                    case Driver::PlannerEngine::BATCH:
+                        std::cout << "Switching to parallel planner" << std::endl;
+                        driver.setPlannerEngine(Driver::PlannerEngine::PARALLEL);
+                        break;
+                    case Driver::PlannerEngine::PARALLEL:
+                        std::cout << "Switching to recursive planner" << std::endl;
+                        driver.setPlannerEngine(Driver::PlannerEngine::RECURSIVE);
+                        break;
+                }
+            } else if (key == 't') {
+                if (tracer::enabled()) {
+                    tracer::setEnabled(false);
+                    std::cout << "Tracing stopped, writing " << TRACE_FILE << std::endl;
+                    tracer::dump(TRACE_FILE);
+                } else {
+                    std::cout << "Tracing" << std::endl;
+                    tracer::setEnabled(true);
+                }
             } else if (key == 'm') {
                 std::cout << "Switching to manual" << std::endl;
                 humanDriving = true;
             } else if (key == 'r') {
-                recordFeed = !recordFeed;
-                if (!recordFeed) {
+                if (recordFeed) {
                     std::cout << "Saving feed" << std::endl;
-                    recording.save(display);
+                    recording.save();
                 } else {
                     std::cout << "Recording feed" << std::endl;
-                    recording.startRecording();
+                    recording.startRecording(display);
                 }
+                recordFeed = recording.getState() == Recording::RECORDING;
             } else if (key == 's') {
                 cv::imwrite("screen" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + ".jpg", display.getCurrentFrame());
                 cv::imwrite("screen" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + ".jpg", thresholdedBird + thresholdedWorld);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "arm.hpp"
+#include "constants.hpp"
+
+/// Arm that doesn't tap anything, for running the Driver offline. Has the simulated arm's timing so that planning does
+/// the same amount of work as it would live.
+class NullArm : public Arm {
+public:
+    void tap() override {
+        ++m_taps;
+    }
+
+    std::chrono::milliseconds liftDelay() const override {
+        return SIMULATED_ARM_LIFT_DELAY;
+    }
+
+    std::chrono::milliseconds tapDelay() const override {
+        return SIMULATED_ARM_TAP_DELAY;
+    }
+
+    int taps() const {
+        return m_taps;
+    }
+
+private:
+    int m_taps{0};
+};
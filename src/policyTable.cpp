@@ -0,0 +1,245 @@
+#include "policyTable.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "constants.hpp"
+
+namespace policy_file {
+
+uint32_t cellCount(const Header& header, Dimension dimension) {
+    return header.axes[dimension].count + (dimension == NEXT_GAP_TOP ? 1 : 0);
+}
+
+size_t entryCount(const Header& header) {
+    size_t count = 1;
+    for (size_t dimension = 0; dimension < DIMENSIONS; ++dimension) {
+        count *= cellCount(header, static_cast<Dimension>(dimension));
+    }
+    return count;
+}
+
+size_t index(const Header& header, const Cells& cells) {
+    size_t index = 0;
+    for (size_t dimension = 0; dimension < DIMENSIONS; ++dimension) {
+        index = index * cellCount(header, static_cast<Dimension>(dimension)) + cells[dimension];
+    }
+    return index;
+}
+
+Cells cells(const Header& header, size_t index) {
+    Cells cells;
+    for (size_t dimension = DIMENSIONS; dimension-- > 0; ) {
+        const uint32_t count = cellCount(header, static_cast<Dimension>(dimension));
+        cells[dimension] = static_cast<uint32_t>(index % count);
+        index /= count;
+    }
+    return cells;
+}
+
+uint32_t searchFlags(bool sweptCollision, bool adaptiveStep) {
+    return (sweptCollision ? uint32_t{SWEPT_COLLISION} : 0) | (adaptiveStep ? uint32_t{ADAPTIVE_STEP} : 0);
+}
+
+void write(const std::string& path, const Header& header, const std::vector<Entry>& entries) {
+    if (entries.size() != entryCount(header)) {
+        throw std::runtime_error("the policy table has " + std::to_string(entries.size()) + " entries, its grid "
+                                 + std::to_string(entryCount(header)));
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Couldn't open " + path + " for writing");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Writing the policy table failed");
+    }
+}
+
+} // namespace policy_file
+
+using namespace policy_file;
+
+PolicyTable::PolicyTable(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Couldn't open " + path);
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is too short to be a policy table");
+    }
+    m_size = status.st_size;
+
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Couldn't map " + path);
+    }
+    m_data = static_cast<uint8_t*>(mapping);
+
+    std::memcpy(&m_header, m_data, sizeof(m_header));
+    std::string error;
+    if (std::memcmp(m_header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + " isn't a policy table";
+    } else if (m_header.version != VERSION) {
+        error = path + " has unsupported version " + std::to_string(m_header.version);
+    } else if (sizeof(Header) + entryCount(m_header) * sizeof(Entry) != m_size) {
+        error = path + " doesn't match its grid";
+    } else {
+        for (size_t dimension = 0; dimension < DIMENSIONS; ++dimension) {
+            if (m_header.axes[dimension].count == 0 || !(m_header.axes[dimension].step > 0)) {
+                error = path + " has an empty axis";
+            }
+        }
+    }
+
+    if (!error.empty()) {
+        munmap(m_data, m_size);
+        throw std::runtime_error(error);
+    }
+    m_entries = reinterpret_cast<const Entry*>(m_data + sizeof(Header));
+}
+
+PolicyTable::~PolicyTable() {
+    munmap(m_data, m_size);
+}
+
+// The one or two cells either side of `value` along `axis`, none if it's off the grid.
+static std::optional<std::pair<uint32_t, uint32_t>> bracket(const Axis& axis, float value) {
+    const float position = (value - axis.min) / axis.step;
+    // right on a cell (the cooldown usually is), give or take rounding
+    const float nearest = std::round(position);
+    if (std::abs(position - nearest) < 0.001f) {
+        if (!(nearest >= 0 && nearest < axis.count)) {
+            return {};
+        }
+        return std::pair<uint32_t, uint32_t>{static_cast<uint32_t>(nearest), static_cast<uint32_t>(nearest)};
+    }
+    if (!(position > 0 && position < axis.count - 1)) {
+        return {};
+    }
+    const uint32_t lower = static_cast<uint32_t>(position);
+    return std::pair<uint32_t, uint32_t>{lower, lower + 1};
+}
+
+void PolicyTable::checkSearchSettings(std::chrono::milliseconds tapDelay, std::chrono::milliseconds liftDelay,
+                                      TimePoint::duration quantum, bool sweptCollision, bool adaptiveStep) const {
+    if (m_header.tapDelay != tapDelay.count() || m_header.liftDelay != liftDelay.count()) {
+        throw std::invalid_argument("the policy table was computed for different arm delays");
+    }
+    if (m_header.searchQuantum != quantum.count()) {
+        throw std::invalid_argument("the policy table was computed for a different search quantum");
+    }
+    if (m_header.searchFlags != searchFlags(sweptCollision, adaptiveStep)) {
+        throw std::invalid_argument("the policy table was computed with different swept collision or adaptive step "
+                                    "settings");
+    }
+}
+
+bool PolicyTable::matchesGeometry(Coordinate groundLevel, Distance boundaryAhead) const {
+    return std::abs(groundLevel.val - m_header.groundLevel) <= POLICY_GEOMETRY_TOLERANCE.val
+           && std::abs(boundaryAhead.val - m_header.boundaryAhead) <= POLICY_GEOMETRY_TOLERANCE.val;
+}
+
+void PolicyTable::warnUnlessMatches(Coordinate groundLevel, Distance boundaryAhead) const {
+    if (!matchesGeometry(groundLevel, boundaryAhead)) {
+        std::cerr << "Warning: the policy table is for the ground at " << m_header.groundLevel << " and the right "
+                  << "boundary " << m_header.boundaryAhead << " ahead of the bird, they're at " << groundLevel.val
+                  << " and " << boundaryAhead.val << " - it won't be used (see generatePolicy --saved-boundaries)"
+                  << std::endl;
+    }
+}
+
+std::optional<PolicyTable::Decision> PolicyTable::lookup(
+        const Motion& motion,
+        TimePoint::duration sinceLastTap,
+        const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps) const {
+    if (!gaps.first) {
+        return {};
+    }
+    const Gap& gap = gaps.first.value();
+
+    // gaps that aren't the size (or as far apart) as the table assumes aren't in it, however close the rest is
+    const Axis& gapX = m_header.axes[GAP_X];
+    const Axis& gapTop = m_header.axes[GAP_TOP];
+    if (std::abs((gap.lowerRight.x - gap.lowerLeft.x).val - m_header.pipeWidth) > gapX.step
+            || std::abs((gap.lowerLeft.y - gap.upperLeft.y).val - m_header.gapHeight) > gapTop.step) {
+        return {};
+    }
+    if (gaps.second
+            && std::abs((gaps.second->lowerLeft.x - gap.lowerRight.x).val - m_header.pipeSpacing) > gapX.step) {
+        return {};
+    }
+
+    // same as the search's cooldown, see Driver::searchKey()
+    const TimePoint::duration cooldown = std::min(sinceLastTap,
+                                                  TimePoint::duration{m_header.liftDelay} + TimePoint::duration{1});
+
+    std::array<std::pair<uint32_t, uint32_t>, DIMENSIONS> brackets;
+    const std::pair<Dimension, float> values[] = {
+            {BIRD_Y, motion.position.y.val},
+            {VERTICAL_SPEED, motion.verticalSpeed.val.val},
+            {SINCE_LAST_TAP, static_cast<float>(cooldown.count())},
+            {GAP_X, (gap.lowerLeft.x - motion.position.x).val},
+            {GAP_TOP, gap.upperLeft.y.val}};
+    for (const std::pair<Dimension, float>& value : values) {
+        const std::optional<std::pair<uint32_t, uint32_t>> cells = bracket(m_header.axes[value.first], value.second);
+        if (!cells) {
+            return {};
+        }
+        brackets[value.first] = cells.value();
+    }
+    if (gaps.second) {
+        const std::optional<std::pair<uint32_t, uint32_t>> cells = bracket(m_header.axes[NEXT_GAP_TOP],
+                                                                           gaps.second->upperLeft.y.val);
+        if (!cells) {
+            return {};
+        }
+        brackets[NEXT_GAP_TOP] = cells.value();
+    } else {
+        brackets[NEXT_GAP_TOP] = {m_header.axes[NEXT_GAP_TOP].count, m_header.axes[NEXT_GAP_TOP].count};
+    }
+
+    // The state is somewhere between the centres of up to 2^DIMENSIONS cells. The decision only stands if they all
+    // agree, and with the smallest of their clearances - a single nearest cell is wrong too often near the boundary
+    // between tapping and not.
+    std::optional<Decision> decision;
+    for (uint32_t corner = 0; corner < (1u << DIMENSIONS); ++corner) {
+        Cells cells;
+        bool duplicate = false;
+        for (size_t dimension = 0; dimension < DIMENSIONS; ++dimension) {
+            const bool upper = corner & (1u << dimension);
+            duplicate |= upper && brackets[dimension].first == brackets[dimension].second;
+            cells[dimension] = upper ? brackets[dimension].second : brackets[dimension].first;
+        }
+        if (duplicate) {
+            continue;
+        }
+
+        const Entry& entry = m_entries[index(m_header, cells)];
+        const Decision cornerDecision{static_cast<Action>(entry.action), Distance{entry.clearance * CLEARANCE_UNIT}};
+        if (!decision) {
+            decision = cornerDecision;
+        } else if (decision->action != cornerDecision.action) {
+            return {};
+        } else {
+            decision->clearance = std::min(decision->clearance, cornerDecision.clearance);
+        }
+    }
+    return decision;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "action.hpp"
+#include "gap.hpp"
+#include "units.hpp"
+
+/*
+ * The Driver's decisions, computed offline (by generatePolicy) over a grid of game states and memory mapped at run
+ * time, so that a decision is a lookup rather than a search:
+ *
+ *   header | entry | entry | ...
+ *
+ * A state is the bird's height and vertical speed, the time since the last tap and where the next one or two gaps
+ * are. Everything else is fixed by the game - the gaps' size and spacing, where the ground and the right boundary are -
+ * and recorded in the header, so that the table is only used where it applies. Entries are laid out row major, in the
+ * order of the dimensions below.
+ */
+namespace policy_file {
+
+constexpr char MAGIC[8] = {'F', 'L', 'A', 'P', 'P', 'O', 'L', '\0'};
+constexpr uint32_t VERSION = 2;
+
+enum Dimension : size_t {
+    BIRD_Y,
+    VERTICAL_SPEED,
+    SINCE_LAST_TAP, // ms, clamped to just past the lift delay like the search does
+    GAP_X, // left edge of the next gap, from the bird
+    GAP_TOP,
+    NEXT_GAP_TOP, // has an extra cell past the last one, for when there's no second gap
+    DIMENSIONS
+};
+
+/// Search settings that change the decisions, besides the arm's delays and the quantum. Or'ed into Header::searchFlags.
+enum SearchFlags : uint32_t {
+    SWEPT_COLLISION = 1, // Driver::setSweptCollision()
+    ADAPTIVE_STEP = 2 // Driver::setAdaptiveStep()
+};
+
+/// The SearchFlags for the given Driver settings.
+uint32_t searchFlags(bool sweptCollision, bool adaptiveStep);
+
+/// Cell i is centred on min + i * step.
+struct Axis {
+    float min;
+    float step;
+    uint32_t count;
+    uint32_t reserved;
+};
+static_assert(sizeof(Axis) == 16, "axes are written as is");
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t searchFlags; // SearchFlags
+    int32_t tapDelay; // ms, of the arm the table was computed for
+    int32_t liftDelay; // ms
+    int32_t searchQuantum; // ms
+    float groundLevel;
+    float boundaryAhead; // right boundary, from the bird
+    float gapHeight;
+    float pipeWidth;
+    float pipeSpacing; // from the right edge of a gap to the left edge of the next one
+    Axis axes[DIMENSIONS];
+};
+static_assert(sizeof(Header) == 144, "the header is written as is");
+
+struct Entry {
+    uint16_t clearance; // in CLEARANCE_UNITs, saturated
+    uint8_t action; // an Action
+    uint8_t reserved;
+};
+static_assert(sizeof(Entry) == 4, "entries are written as is");
+
+constexpr float CLEARANCE_UNIT = 0.0001f;
+
+using Cells = std::array<uint32_t, DIMENSIONS>;
+
+/// Number of cells along `dimension`, including NEXT_GAP_TOP's extra one.
+uint32_t cellCount(const Header& header, Dimension dimension);
+size_t entryCount(const Header& header);
+
+size_t index(const Header& header, const Cells& cells);
+Cells cells(const Header& header, size_t index);
+
+/// Throws std::runtime_error if the file can't be written.
+void write(const std::string& path, const Header& header, const std::vector<Entry>& entries);
+
+} // namespace policy_file
+
+/**
+ * Read-only view of a policy file. Throws std::runtime_error if the file can't be opened or isn't a policy table.
+ * Lookups don't touch anything but the mapping, so one table can serve any number of threads.
+ */
+class PolicyTable {
+public:
+    explicit PolicyTable(const std::string& path);
+    ~PolicyTable();
+
+    PolicyTable(const PolicyTable&) = delete;
+    PolicyTable& operator=(const PolicyTable&) = delete;
+
+    struct Decision {
+        Action action;
+        Distance clearance; // the search's, the smallest from the centres of the cells
+    };
+
+    const policy_file::Header& header() const {
+        return m_header;
+    }
+
+    /// Throws std::invalid_argument unless the table was computed for these arm delays and search settings.
+    void checkSearchSettings(std::chrono::milliseconds tapDelay, std::chrono::milliseconds liftDelay,
+                             TimePoint::duration quantum, bool sweptCollision, bool adaptiveStep) const;
+
+    /// Whether the ground and the right boundary (`boundaryAhead` of the bird) are within POLICY_GEOMETRY_TOLERANCE of
+    /// where they were when the table was computed. It doesn't apply anywhere otherwise.
+    bool matchesGeometry(Coordinate groundLevel, Distance boundaryAhead) const;
+    /// Warns on std::cerr if the table doesn't match the geometry, see matchesGeometry().
+    void warnUnlessMatches(Coordinate groundLevel, Distance boundaryAhead) const;
+
+    /// The decision of the cells around the given state, if they all agree. No value if they don't, if it's off the
+    /// grid or if the gaps aren't laid out the way the table assumes.
+    std::optional<Decision> lookup(const Motion& motion,
+                                   TimePoint::duration sinceLastTap,
+                                   const std::pair<std::optional<Gap>, std::optional<Gap>>& gaps) const;
+
+private:
+    uint8_t* m_data{nullptr};
+    size_t m_size{0};
+    policy_file::Header m_header;
+    const policy_file::Entry* m_entries{nullptr};
+};
@@ -0,0 +1,192 @@
+#include "recordingFile.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace recording_file;
+
+RecordingWriter::RecordingWriter(const std::string& path, const VideoFeed::Viewport& viewport)
+        : m_file(path, std::ios::binary | std::ios::trunc) {
+    if (!m_file) {
+        throw std::runtime_error("Couldn't open " + path + " for writing");
+    }
+
+    std::memset(&m_header, 0, sizeof(m_header));
+    std::memcpy(m_header.magic, MAGIC, sizeof(MAGIC));
+    m_header.version = VERSION;
+    m_header.bottomLeftX = viewport.bottomLeft.x;
+    m_header.bottomLeftY = viewport.bottomLeft.y;
+    m_header.bottomRightX = viewport.bottomRight.x;
+    m_header.bottomRightY = viewport.bottomRight.y;
+    m_header.viewportHeight = viewport.height;
+    m_header.unitLength = viewport.unitLength;
+
+    // rewritten with the frame count and index offset in finish()
+    write(&m_header, sizeof(m_header));
+}
+
+RecordingWriter::~RecordingWriter() {
+    if (!m_finished && m_file.is_open()) {
+        try {
+            finish();
+        } catch (std::runtime_error&) {
+            // nothing sensible to do in a destructor, the recording just won't open
+        }
+    }
+}
+
+void RecordingWriter::append(TimePoint::duration timestamp, const cv::Mat& frame) {
+    assert(!m_finished);
+    assert(frame.dims == 2);
+
+    pad(FRAME_ALIGNMENT);
+
+    m_index.push_back({timestamp.count(), m_offset, frame.rows, frame.cols, frame.type(), 0});
+
+    const size_t rowSize = frame.cols * frame.elemSize();
+    if (frame.isContinuous()) {
+        write(frame.data, rowSize * frame.rows);
+    } else {
+        for (int row = 0; row < frame.rows; ++row) {
+            write(frame.ptr(row), rowSize);
+        }
+    }
+}
+
+void RecordingWriter::finish() {
+    assert(!m_finished);
+    m_finished = true;
+
+    // the index is read in place from the mapping, so it has to be aligned whatever size the last frame was
+    pad(alignof(IndexEntry));
+    m_header.indexOffset = m_offset;
+    m_header.frameCount = static_cast<uint32_t>(m_index.size());
+    write(m_index.data(), m_index.size() * sizeof(IndexEntry));
+
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_file.close();
+    if (!m_file) {
+        throw std::runtime_error("Couldn't finish writing the recording");
+    }
+}
+
+void RecordingWriter::write(const void* data, size_t size) {
+    m_file.write(static_cast<const char*>(data), size);
+    if (!m_file) {
+        throw std::runtime_error("Writing the recording failed");
+    }
+    m_offset += size;
+}
+
+void RecordingWriter::pad(uint64_t alignment) {
+    assert(alignment <= FRAME_ALIGNMENT);
+    static const char padding[FRAME_ALIGNMENT] = {};
+    const uint64_t misalignment = m_offset % alignment;
+    if (misalignment != 0) {
+        write(padding, alignment - misalignment);
+    }
+}
+
+MappedRecording::MappedRecording(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Couldn't open " + path);
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is too short to be a recording");
+    }
+    m_size = status.st_size;
+
+    void* mapping = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Couldn't map " + path);
+    }
+    m_data = static_cast<uint8_t*>(mapping);
+
+    std::memcpy(&m_header, m_data, sizeof(m_header));
+    const uint64_t indexSize = uint64_t{m_header.frameCount} * sizeof(IndexEntry);
+    std::string error;
+    if (std::memcmp(m_header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + " isn't a recording";
+    } else if (m_header.version != VERSION) {
+        error = path + " has unsupported version " + std::to_string(m_header.version);
+    } else if (m_header.indexOffset == 0) {
+        error = path + " wasn't finished, it has no index";
+    } else if (m_header.indexOffset % alignof(IndexEntry) != 0 || m_header.indexOffset + indexSize > m_size) {
+        error = path + " has a corrupt index";
+    }
+
+    if (error.empty()) {
+        m_index = reinterpret_cast<const IndexEntry*>(m_data + m_header.indexOffset);
+        for (size_t i = 0; i < frameCount() && error.empty(); ++i) {
+            const IndexEntry& entry = m_index[i];
+            const uint64_t frameSize = uint64_t(entry.rows) * entry.cols * CV_ELEM_SIZE(entry.type);
+            if (entry.rows <= 0 || entry.cols <= 0 || entry.offset + frameSize > m_header.indexOffset) {
+                error = path + ": frame " + std::to_string(i) + " is out of bounds";
+            }
+        }
+    }
+
+    if (!error.empty()) {
+        munmap(m_data, m_size);
+        throw std::runtime_error(error);
+    }
+}
+
+MappedRecording::~MappedRecording() {
+    munmap(m_data, m_size);
+}
+
+cv::Mat MappedRecording::frame(size_t frame) const {
+    assert(frame < frameCount());
+    const IndexEntry& entry = m_index[frame];
+    return cv::Mat(entry.rows, entry.cols, entry.type, m_data + entry.offset);
+}
+
+VideoFeed::Viewport MappedRecording::viewport() const {
+    return {cv::Point(m_header.bottomLeftX, m_header.bottomLeftY),
+            cv::Point(m_header.bottomRightX, m_header.bottomRightY),
+            m_header.viewportHeight,
+            m_header.unitLength};
+}
+
+void convertLegacyRecording(const std::string& xmlPath, const std::string& outputPath) {
+    cv::FileStorage fs(xmlPath, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        throw std::runtime_error("Couldn't open " + xmlPath);
+    }
+
+    cv::FileNode frames = fs["frames"];
+    cv::FileNode timestamps = fs["timestamps"];
+    if (frames.type() != cv::FileNode::SEQ || timestamps.type() != cv::FileNode::SEQ) {
+        throw std::runtime_error(xmlPath + " doesn't have frame and timestamp sequences");
+    }
+    if (frames.size() != timestamps.size()) {
+        throw std::runtime_error(xmlPath + " has " + std::to_string(frames.size()) + " frames but "
+                                 + std::to_string(timestamps.size()) + " timestamps");
+    }
+
+    RecordingWriter writer(outputPath, VideoFeed::deserialiseViewport(fs));
+
+    cv::FileNodeIterator timestamp = timestamps.begin();
+    for (cv::FileNodeIterator it = frames.begin(); it != frames.end(); ++it, ++timestamp) {
+        cv::Mat frame;
+        *it >> frame;
+        int milliseconds; // the only integral type cv::FileStorage supports
+        *timestamp >> milliseconds;
+        writer.append(TimePoint::duration{milliseconds}, frame);
+    }
+
+    writer.finish();
+}
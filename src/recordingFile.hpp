@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "display.hpp"
+#include "units.hpp"
+
+/*
+ * Binary recording container, laid out so that it can be memory mapped and played back in place:
+ *
+ *   header | frame | frame | ... | index
+ *
+ * The header holds the VideoFeed viewport and where the index starts, the index has a timestamp, offset and shape for
+ * every frame. Frames are stored raw and start at a cache-line-aligned offset, so a cv::Mat can point straight into
+ * the mapping - decompressing would mean a copy of every frame, which is exactly what we're avoiding.
+ */
+namespace recording_file {
+
+constexpr char MAGIC[8] = {'F', 'L', 'A', 'P', 'R', 'E', 'C', '\0'};
+constexpr uint32_t VERSION = 1;
+constexpr uint64_t FRAME_ALIGNMENT = 64;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t frameCount;
+    uint64_t indexOffset; // 0 until the writer finishes
+    int32_t bottomLeftX;
+    int32_t bottomLeftY;
+    int32_t bottomRightX;
+    int32_t bottomRightY;
+    int32_t viewportHeight;
+    int32_t unitLength;
+};
+static_assert(sizeof(Header) == 48, "the header is written as is");
+
+struct IndexEntry {
+    int64_t timestamp; // ms since the start of the recording
+    uint64_t offset; // of the first pixel, from the start of the file
+    int32_t rows;
+    int32_t cols;
+    int32_t type; // OpenCV's, e.g. CV_8UC4
+    int32_t reserved;
+};
+static_assert(sizeof(IndexEntry) == 32, "index entries are written as is");
+
+} // namespace recording_file
+
+/**
+ * Writes a recording frame by frame, nothing is buffered apart from the (small) index. The recording is only valid
+ * once finish() has been called. Throws std::runtime_error on I/O errors.
+ */
+class RecordingWriter {
+public:
+    RecordingWriter(const std::string& path, const VideoFeed::Viewport& viewport);
+    ~RecordingWriter();
+
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    /// @param timestamp since the start of the recording
+    void append(TimePoint::duration timestamp, const cv::Mat& frame);
+    /// Writes out the index, after which nothing more can be appended.
+    void finish();
+
+    size_t frameCount() const {
+        return m_index.size();
+    }
+
+private:
+    void write(const void* data, size_t size);
+    /// Writes zeros up to the next multiple of `alignment` (at most FRAME_ALIGNMENT).
+    void pad(uint64_t alignment);
+
+    std::ofstream m_file;
+    recording_file::Header m_header;
+    std::vector<recording_file::IndexEntry> m_index;
+    uint64_t m_offset{0};
+    bool m_finished{false};
+};
+
+/**
+ * Read-only view of a recording file. Opening it only maps the file and checks the index, frames are paged in when
+ * first touched. Throws std::runtime_error if the file can't be opened or isn't a (finished) recording.
+ */
+class MappedRecording {
+public:
+    explicit MappedRecording(const std::string& path);
+    ~MappedRecording();
+
+    MappedRecording(const MappedRecording&) = delete;
+    MappedRecording& operator=(const MappedRecording&) = delete;
+
+    size_t frameCount() const {
+        return m_header.frameCount;
+    }
+
+    TimePoint::duration timestamp(size_t frame) const {
+        return TimePoint::duration{m_index[frame].timestamp};
+    }
+
+    /// Points into the mapping, valid as long as this object is. Private mapping, so drawing on it is fine - the pages
+    /// touched are copied rather than written back to the file.
+    cv::Mat frame(size_t frame) const;
+
+    VideoFeed::Viewport viewport() const;
+
+private:
+    uint8_t* m_data{nullptr};
+    size_t m_size{0};
+    recording_file::Header m_header;
+    const recording_file::IndexEntry* m_index{nullptr};
+};
+
+/// Converts a recording.xml written by cv::FileStorage (the old format) into the binary one, frame by frame.
+void convertLegacyRecording(const std::string& xmlPath, const std::string& outputPath);
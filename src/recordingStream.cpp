@@ -0,0 +1,110 @@
+#include "recordingStream.hpp"
+
+#include "tracer.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+RecordingStream::RecordingStream(const std::string& path, const VideoFeed::Viewport& viewport, size_t queueLength)
+        : m_writer{path, viewport}, m_slots(queueLength), m_thread{&RecordingStream::run, this} {
+    assert(queueLength > 0);
+}
+
+RecordingStream::~RecordingStream() {
+    if (m_thread.joinable()) {
+        try {
+            finish();
+        } catch (std::runtime_error&) {
+            // already reported by the writer thread
+        }
+    }
+}
+
+bool RecordingStream::push(TimePoint::duration timestamp, const cv::Mat& frame) {
+    const std::optional<size_t> slot = reserveSlot();
+    if (!slot) {
+        return false;
+    }
+
+    m_slots[*slot].timestamp = timestamp;
+    frame.copyTo(m_slots[*slot].image);
+    commitSlot();
+    return true;
+}
+
+bool RecordingStream::push(TimePoint::duration timestamp, const PooledFrame& frame) {
+    const std::optional<size_t> slot = reserveSlot();
+    if (!slot) {
+        return false;
+    }
+
+    m_slots[*slot].timestamp = timestamp;
+    m_slots[*slot].pooled = frame;
+    commitSlot();
+    return true;
+}
+
+std::optional<size_t> RecordingStream::reserveSlot() {
+    std::unique_lock<std::mutex> _(m_mutex);
+    assert(!m_stopping);
+    if (m_queued == m_slots.size() || m_failed) {
+        ++m_dropped;
+        return {};
+    }
+    // the writer doesn't touch the slot until it's counted as queued, so it can be filled without holding the lock
+    return (m_head + m_queued) % m_slots.size();
+}
+
+void RecordingStream::commitSlot() {
+    {
+        std::unique_lock<std::mutex> _(m_mutex);
+        ++m_queued;
+    }
+    m_frameQueued.notify_one();
+}
+
+void RecordingStream::finish() {
+    {
+        std::unique_lock<std::mutex> _(m_mutex);
+        m_stopping = true;
+    }
+    m_frameQueued.notify_one();
+    m_thread.join();
+
+    if (m_failed) {
+        throw std::runtime_error(m_error);
+    }
+}
+
+void RecordingStream::run() {
+    tracer::setThreadName("recording writer");
+    try {
+        while (true) {
+            size_t slot;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_frameQueued.wait(lock, [&]() { return m_stopping || m_queued > 0; });
+                if (m_queued == 0) {
+                    break; // stopping and everything has been written
+                }
+                slot = m_head;
+            }
+
+            // the producer never touches the head slot while it's queued
+            Slot& queued = m_slots[slot];
+            TRACE_SPAN("write frame");
+            m_writer.append(queued.timestamp, queued.pooled ? queued.pooled.image() : queued.image);
+            queued.pooled.reset(); // back to the pool
+            ++m_written;
+
+            std::unique_lock<std::mutex> _(m_mutex);
+            m_head = (m_head + 1) % m_slots.size();
+            --m_queued;
+        }
+
+        m_writer.finish();
+    } catch (std::exception& ex) {
+        m_error = ex.what();
+        m_failed = true;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "display.hpp"
+#include "framePool.hpp"
+#include "recordingFile.hpp"
+#include "units.hpp"
+
+/**
+ * Streams a recording to disk as it's being made. Frames are copied into a fixed number of slots and appended to the
+ * file by a background thread, so memory stays bounded however long we record for and the main loop only pays for
+ * the copy. If the disk falls behind and every slot is still waiting to be written, new frames are dropped (and
+ * counted) rather than blocking the caller.
+ */
+class RecordingStream {
+public:
+    /// @param queueLength number of frames that can be waiting to be written at any one time
+    /// @throws std::runtime_error if the file can't be created
+    RecordingStream(const std::string& path, const VideoFeed::Viewport& viewport, size_t queueLength = 16);
+    ~RecordingStream();
+
+    RecordingStream(const RecordingStream&) = delete;
+    RecordingStream& operator=(const RecordingStream&) = delete;
+
+    /// Queues a copy of the frame. Single producer - only ever call from one thread.
+    /// @return false if it had to be dropped
+    bool push(TimePoint::duration timestamp, const cv::Mat& frame);
+    /// Same, but holds on to the pooled buffer until it's been written instead of copying it.
+    bool push(TimePoint::duration timestamp, const PooledFrame& frame);
+
+    /// Writes out whatever is still queued and finishes the file, nothing can be pushed afterwards.
+    /// @throws std::runtime_error if writing failed at any point
+    void finish();
+
+    uint64_t droppedFrames() const {
+        return m_dropped;
+    }
+
+    size_t writtenFrames() const {
+        return m_written;
+    }
+
+private:
+    struct Slot {
+        TimePoint::duration timestamp;
+        PooledFrame pooled; // written instead of image if set
+        cv::Mat image; // keeps its buffer between uses
+    };
+
+    /// Index of the slot to fill, if there's one free.
+    std::optional<size_t> reserveSlot();
+    void commitSlot();
+    void run();
+
+    RecordingWriter m_writer;
+    // slots [m_head, m_head + m_queued) (wrapping around) are waiting to be written, the rest are free
+    std::vector<Slot> m_slots;
+    size_t m_head{0};
+    size_t m_queued{0};
+    bool m_stopping{false};
+    std::mutex m_mutex;
+    std::condition_variable m_frameQueued;
+
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<size_t> m_written{0};
+    std::atomic<bool> m_failed{false};
+    std::string m_error; // set before m_failed
+    std::thread m_thread; // last, so everything else is ready by the time it starts
+};
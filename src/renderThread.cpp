@@ -0,0 +1,132 @@
+#include "renderThread.hpp"
+#include "tracer.hpp"
+
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+RenderThread::RenderThread(const std::string& windowName, std::chrono::milliseconds interval)
+        : m_windowName{windowName}, m_interval{interval}, m_thread{&RenderThread::run, this} {}
+
+RenderThread::~RenderThread() {
+    m_running = false;
+    m_thread.join();
+}
+
+bool RenderThread::wantsFrame() const {
+    std::unique_lock<std::mutex> _(m_frameMutex);
+    return !m_pendingFrame && std::chrono::steady_clock::now() >= m_nextRender;
+}
+
+void RenderThread::submit(PooledFrame frame, DrawList overlays, AuxiliaryFrames auxiliary) {
+    std::unique_lock<std::mutex> _(m_frameMutex);
+    m_pendingFrame = std::move(frame);
+    m_pendingOverlays = std::move(overlays);
+    m_pendingAuxiliary = std::move(auxiliary);
+}
+
+std::shared_ptr<const std::atomic<int>> RenderThread::addTrackbar(const std::string& window, const std::string& name,
+                                                                  int initial, int max) {
+    const std::shared_ptr<std::atomic<int>> value = std::make_shared<std::atomic<int>>(initial);
+    std::unique_lock<std::mutex> _(m_frameMutex);
+    m_newTrackbars.push_back({window, name, max, value});
+    return value;
+}
+
+std::optional<RenderThread::Event> RenderThread::nextEvent(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_eventMutex);
+    if (!m_eventAdded.wait_for(lock, timeout, [this]() { return !m_events.empty(); })) {
+        return {};
+    }
+    const Event event = m_events.front();
+    m_events.pop_front();
+    return event;
+}
+
+void RenderThread::pushEvent(const Event& event) {
+    {
+        std::unique_lock<std::mutex> _(m_eventMutex);
+        m_events.push_back(event);
+    }
+    m_eventAdded.notify_one();
+}
+
+void RenderThread::onMouse(int event, int x, int y, int /*flags*/, void* userdata) {
+    if (event == cv::EVENT_LBUTTONDOWN) {
+        static_cast<RenderThread*>(userdata)->pushEvent({Event::Type::CLICK, -1, cv::Point(x, y)});
+    }
+}
+
+void RenderThread::onTrackbar(int position, void* userdata) {
+    static_cast<std::atomic<int>*>(userdata)->store(position);
+}
+
+static void draw(cv::Mat& canvas, const Overlay& overlay) {
+    switch (overlay.shape) {
+        case Overlay::Shape::MARK: {
+            const cv::Point& loc = overlay.centre;
+            cv::line(canvas, cv::Point(loc.x - 20, loc.y), cv::Point(loc.x + 20, loc.y), overlay.colour, 2);
+            cv::line(canvas, cv::Point(loc.x, loc.y - 20), cv::Point(loc.x, loc.y + 20), overlay.colour, 2);
+            break;
+        }
+        case Overlay::Shape::CIRCLE:
+            cv::circle(canvas, overlay.centre, overlay.radius, overlay.colour, 2);
+            break;
+        case Overlay::Shape::FILLED_CIRCLE:
+            cv::circle(canvas, overlay.centre, overlay.radius, overlay.colour, cv::FILLED);
+            break;
+    }
+}
+
+void RenderThread::run() {
+    tracer::setThreadName("render");
+    cv::namedWindow(m_windowName);
+    cv::setMouseCallback(m_windowName, onMouse, this);
+
+    while (m_running) {
+        PooledFrame frame;
+        DrawList overlays;
+        AuxiliaryFrames auxiliary;
+        std::vector<Trackbar> newTrackbars;
+        {
+            std::unique_lock<std::mutex> _(m_frameMutex);
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (m_pendingFrame && now >= m_nextRender) {
+                frame = std::move(m_pendingFrame);
+                overlays.swap(m_pendingOverlays);
+                auxiliary.swap(m_pendingAuxiliary);
+                m_nextRender = now + m_interval;
+            }
+            newTrackbars.swap(m_newTrackbars);
+        }
+
+        for (Trackbar& trackbar : newTrackbars) {
+            cv::namedWindow(trackbar.window, cv::WINDOW_AUTOSIZE);
+            const int initial = trackbar.value->load();
+            cv::createTrackbar(trackbar.name, trackbar.window, nullptr, trackbar.max, onTrackbar, trackbar.value.get());
+            cv::setTrackbarPos(trackbar.name, trackbar.window, initial);
+            m_trackbars.push_back(std::move(trackbar));
+        }
+
+        if (frame && !frame.image().empty()) {
+            TRACE_SPAN("render");
+            frame.image().copyTo(m_canvas);
+            frame.reset(); // back to the pool as soon as possible, the canvas is ours
+            for (const Overlay& overlay : overlays) {
+                draw(m_canvas, overlay);
+            }
+            cv::imshow(m_windowName, m_canvas);
+        }
+        for (auto& [window, image] : auxiliary) {
+            cv::imshow(window, image.image());
+            image.reset();
+        }
+
+        // also runs the window's callbacks, clicks included
+        const int key = cv::waitKey(1);
+        if (key != -1) {
+            pushEvent({Event::Type::KEY, key, {}});
+        }
+    }
+
+    cv::destroyAllWindows();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "framePool.hpp"
+
+/// Something drawn over a frame when it's shown, in frame pixels. Recorded rather than drawn straight away so that the
+/// frame itself stays as captured (for the detector and the recorder) and the drawing happens off the main thread.
+struct Overlay {
+    enum class Shape {
+        MARK, // a cross
+        CIRCLE,
+        FILLED_CIRCLE
+    };
+
+    Shape shape;
+    cv::Point centre;
+    int radius; // circles only
+    cv::Scalar colour;
+};
+
+using DrawList = std::vector<Overlay>;
+
+/// Images shown as they are in windows of their own (e.g. masks while calibrating), by window name.
+using AuxiliaryFrames = std::vector<std::pair<std::string, PooledFrame>>;
+
+/**
+ * Shows frames, with their overlays drawn on, in a HighGUI window on a dedicated thread, so that neither the drawing
+ * nor the GUI's event loop is on the way from capturing a frame to tapping. At most one frame is shown per interval,
+ * the ones in between are meant to be skipped (see wantsFrame()) without even being copied.
+ *
+ * HighGUI isn't thread safe and only this thread pumps its events, so while it's running every window has to go
+ * through it: the other windows (sliders, auxiliary frames) are created here on request too. Key presses and clicks in
+ * the main window are queued for the main thread to pick up with nextEvent().
+ */
+class RenderThread {
+public:
+    struct Event {
+        enum class Type {
+            KEY,
+            CLICK
+        };
+
+        Type type;
+        int key; // KEY only, as returned by cv::waitKey()
+        cv::Point click; // CLICK only
+    };
+
+    RenderThread(const std::string& windowName, std::chrono::milliseconds interval);
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    /// Whether a frame submitted now would be shown, rather than skipped - so that it isn't prepared for nothing.
+    bool wantsFrame() const;
+
+    /// Shows the frame at the next opportunity, unless another one is submitted first. The frame mustn't change while
+    /// it's held here, it's only read (into a canvas of the thread's own, the overlays are drawn on that).
+    void submit(PooledFrame frame, DrawList overlays, AuxiliaryFrames auxiliary = {});
+
+    /// A slider from 0 to `max` in `window` (created if need be). The returned value follows the slider, it's
+    /// `initial` until the slider has been created and moved.
+    std::shared_ptr<const std::atomic<int>> addTrackbar(const std::string& window, const std::string& name, int initial,
+                                                        int max);
+
+    /// The oldest event not returned yet, waiting up to `timeout` for one.
+    std::optional<Event> nextEvent(std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+
+private:
+    void run();
+    void pushEvent(const Event& event);
+    static void onMouse(int event, int x, int y, int flags, void* userdata);
+    static void onTrackbar(int position, void* userdata);
+
+    struct Trackbar {
+        std::string window;
+        std::string name;
+        int max;
+        std::shared_ptr<std::atomic<int>> value;
+    };
+
+    const std::string m_windowName;
+    const std::chrono::milliseconds m_interval;
+
+    mutable std::mutex m_frameMutex;
+    PooledFrame m_pendingFrame;
+    DrawList m_pendingOverlays;
+    AuxiliaryFrames m_pendingAuxiliary;
+    std::vector<Trackbar> m_newTrackbars; // not created yet
+    std::chrono::steady_clock::time_point m_nextRender{}; // no frame is wanted before this
+
+    std::mutex m_eventMutex;
+    std::condition_variable m_eventAdded;
+    std::deque<Event> m_events;
+
+    cv::Mat m_canvas; // render thread only
+    std::vector<Trackbar> m_trackbars; // render thread only, keeps the values alive while the sliders may write them
+    std::atomic<bool> m_running{true};
+    std::thread m_thread; // last, so everything else is ready by the time it starts
+};
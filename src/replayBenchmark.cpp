@@ -0,0 +1,178 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "display.hpp"
+#include "driver.hpp"
+#include "featureDetector.hpp"
+#include "latencyStats.hpp"
+#include "nullArm.hpp"
+#include "recordingFile.hpp"
+#include "ReplaySource.hpp"
+#include "toolOptions.hpp"
+#include "tracer.hpp"
+
+/*
+ * Runs detection and planning over every frame of a recording, as fast as they'll go and with no windows, and reports
+ * how long each stage took. The Driver sees the recording's own timestamps through a virtual clock, so every run over
+ * the same recording makes the same decisions (with an unbounded planning budget) and runs are comparable.
+ *
+ * Nothing reacts to the taps - the bird does whatever it did when the recording was made - so this measures the cost
+ * of the pipeline, not how well it plays.
+ *
+ * usage: replayBenchmark [recording.fbr] [--engine recursive|batch|parallel] [--detection full|lazy|pyramid]
+ *                        [--budget-us N] [--repeat N] [--trace trace.json] [--track-gaps]
+ *                        [--track-bird]
+ */
+
+struct Options {
+    std::string recording{"recording.fbr"};
+    Driver::PlannerEngine engine{Driver::PlannerEngine::RECURSIVE};
+    FeatureDetector::Mode detection{FeatureDetector::Mode::LAZY};
+    std::optional<std::chrono::microseconds> budget;
+    int repeat{1};
+    std::optional<std::string> traceFile;
+    bool trackGaps{false};
+    bool trackBird{false};
+};
+
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "--engine") {
+            options.engine = parsePlannerEngine(optionValue(argc, argv, i));
+        } else if (arg == "--detection") {
+            options.detection = parseDetectionMode(optionValue(argc, argv, i));
+        } else if (arg == "--budget-us") {
+            options.budget = std::chrono::microseconds{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--repeat") {
+            options.repeat = std::stoi(optionValue(argc, argv, i));
+        } else if (arg == "--trace") {
+            options.traceFile = optionValue(argc, argv, i);
+        } else if (arg == "--track-gaps") {
+            options.trackGaps = true;
+        } else if (arg == "--track-bird") {
+            options.trackBird = true;
+        } else {
+            options.recording = arg;
+        }
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    try {
+        const Options options = parseOptions(argc, argv);
+        tracer::setEnabled(options.traceFile.has_value());
+
+        MappedRecording recording(options.recording);
+        if (recording.frameCount() == 0) {
+            throw std::runtime_error(options.recording + " has no frames");
+        }
+
+        ReplaySource source(recording);
+        VideoFeed display(source, true);
+        display.setViewport(recording.viewport());
+
+        TimePoint virtualNow{};
+        NullArm arm;
+        Driver driver{arm, display};
+        driver.setClock([&virtualNow]() { return virtualNow; });
+        driver.setPlannerEngine(options.engine);
+        driver.setPlanningBudget(options.budget);
+
+        FeatureDetector detector{display};
+        detector.setMode(options.detection);
+        detector.setGapTracking(options.trackGaps);
+        detector.setBirdTracking(options.trackBird);
+
+        LatencyStats captureStats("capture");
+        LatencyStats detectStats("detect");
+        LatencyStats findBirdStats("findBird");
+        LatencyStats findGapsStats("findGapsAheadOf");
+        LatencyStats planStats("plan");
+        LatencyStats frameStats("frame");
+
+        // keep virtual time going forward across repeats
+        const TimePoint::duration recordingLength = recording.timestamp(recording.frameCount() - 1)
+                                                    + VIRTUAL_PROCESSING_DELAY;
+        bool engaged = false;
+        size_t birdsFound = 0;
+        using Steady = std::chrono::steady_clock;
+
+        const Steady::time_point start = Steady::now();
+        for (int pass = 0; pass < options.repeat; ++pass) {
+            for (size_t i = 0; i < recording.frameCount(); ++i) {
+                const TimePoint frameTime = TimePoint{} + recordingLength * pass + recording.timestamp(i);
+                virtualNow = frameTime;
+                source.seek(i);
+
+                const Steady::time_point frameStart = Steady::now();
+                display.captureFrame();
+                const Steady::time_point captured = Steady::now();
+                detector.process(display.getCurrentFrame(), frameTime);
+                const Steady::time_point detected = Steady::now();
+                const std::optional<Position> birdPos = detector.findBird();
+                const Steady::time_point birdFound = Steady::now();
+
+                captureStats.add(captured - frameStart);
+                detectStats.add(detected - captured);
+                findBirdStats.add(birdFound - detected);
+
+                std::pair<std::optional<Gap>, std::optional<Gap>> gaps;
+                if (birdPos) {
+                    ++birdsFound;
+                    gaps = detector.findGapsAheadOf(birdPos.value());
+                    findGapsStats.add(Steady::now() - birdFound);
+
+                    if (!engaged) {
+                        // same as pressing 'a' live, the driver needs to know when the last tap was
+                        driver.takeOver(birdPos.value());
+                        engaged = true;
+                    }
+                }
+
+                virtualNow = frameTime + VIRTUAL_PROCESSING_DELAY;
+                const Steady::time_point planStart = Steady::now();
+                driver.drive(birdPos, gaps, frameTime, frameTime);
+                const Steady::time_point frameEnd = Steady::now();
+
+                if (birdPos && gaps.first) {
+                    planStats.add(frameEnd - planStart);
+                }
+                frameStats.add(frameEnd - frameStart);
+            }
+        }
+        const std::chrono::duration<double> elapsed = Steady::now() - start;
+
+        const size_t frames = frameStats.count();
+        std::cout << frames << " frames in " << elapsed.count() << "s (" << frames / elapsed.count() << " fps), bird "
+                  << "found in " << birdsFound << ", " << arm.taps() << " taps\n";
+        if (options.trackGaps) {
+            const FeatureDetector::GapTrackingStats tracking = detector.gapTrackingStats();
+            std::cout << "gaps tracked in " << tracking.tracked << ", scanned for in " << tracking.scanned << "\n";
+        }
+        if (options.trackBird) {
+            const FeatureDetector::BirdTrackingStats tracking = detector.birdTrackingStats();
+            std::cout << "bird tracked in " << tracking.tracked << ", searched for in " << tracking.searched << "\n";
+        }
+        std::cout << "\n";
+        LatencyStats::reportHeader(std::cout);
+        for (LatencyStats* stats : {&captureStats, &detectStats, &findBirdStats, &findGapsStats, &planStats,
+                                    &frameStats}) {
+            stats->report(std::cout);
+        }
+
+        if (options.traceFile && !tracer::dump(options.traceFile.value())) {
+            std::cerr << "Couldn't write " << options.traceFile.value() << std::endl;
+        }
+    } catch (std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
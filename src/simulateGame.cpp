@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "simulatedGame.hpp"
+#include "toolOptions.hpp"
+#include "tracer.hpp"
+
+/*
+ * Plays a single game against the GameSimulator (see playSimulatedGame()) and reports how far the bird got and how
+ * long each stage took. batchGames plays lots of them.
+ *
+ * usage: simulateGame [--seed N] [--engine recursive|batch|parallel] [--detection full|lazy|pyramid] [--budget-us N]
+ *                     [--frame-ms N] [--time-limit-s N] [--tracking] [--swept] [--quantum-ms N] [--adaptive]
+ *                     [--warm-start] [--policy table.policy] [--ground-truth] [--trace trace.json]
+ */
+
+struct Options {
+    unsigned seed{0};
+    GameSettings settings;
+    std::optional<std::string> traceFile;
+};
+
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "--seed") {
+            options.seed = static_cast<unsigned>(std::stoul(optionValue(argc, argv, i)));
+        } else if (arg == "--engine") {
+            options.settings.engine = parsePlannerEngine(optionValue(argc, argv, i));
+        } else if (arg == "--detection") {
+            options.settings.detection = parseDetectionMode(optionValue(argc, argv, i));
+        } else if (arg == "--budget-us") {
+            options.settings.budget = std::chrono::microseconds{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--frame-ms") {
+            options.settings.frameInterval = TimePoint::duration{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--time-limit-s") {
+            options.settings.timeLimit = std::chrono::seconds{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--tracking") {
+            options.settings.tracking = true;
+        } else if (arg == "--swept") {
+            options.settings.sweptCollision = true;
+        } else if (arg == "--quantum-ms") {
+            options.settings.searchQuantum = TimePoint::duration{std::stol(optionValue(argc, argv, i))};
+        } else if (arg == "--adaptive") {
+            options.settings.adaptiveStep = true;
+        } else if (arg == "--warm-start") {
+            options.settings.warmStart = true;
+        } else if (arg == "--policy") {
+            options.settings.policy = std::make_shared<const PolicyTable>(optionValue(argc, argv, i));
+        } else if (arg == "--ground-truth") {
+            options.settings.groundTruth = true;
+        } else if (arg == "--trace") {
+            options.traceFile = optionValue(argc, argv, i);
+        } else {
+            throw std::invalid_argument("unknown option: " + arg);
+        }
+    }
+    checkPolicy(options.settings);
+    return options;
+}
+
+int main(int argc, char** argv) {
+    try {
+        const Options options = parseOptions(argc, argv);
+        tracer::setEnabled(options.traceFile.has_value());
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        GameResult result = playSimulatedGame(options.seed, options.settings);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const std::chrono::duration<double> played = result.played;
+
+        std::cout << "score " << result.score << ", crashed into: " << describe(result.crash) << ", " << result.taps
+                  << " taps\n" << played.count() << "s of game in " << elapsed.count() << "s ("
+                  << played.count() / elapsed.count() << "x real time, " << result.frame.count() / elapsed.count()
+                  << " fps)\n" << result.search.decisions << " decisions, "
+                  << static_cast<double>(result.search.nodes) / std::max<size_t>(result.search.decisions, 1)
+                  << " nodes per decision, " << result.search.plansReused << " plans reused\n\n";
+        LatencyStats::reportHeader(std::cout);
+        for (LatencyStats* stats : {&result.detect, &result.plan, &result.frame}) {
+            stats->report(std::cout);
+        }
+
+        if (options.traceFile && !tracer::dump(options.traceFile.value())) {
+            std::cerr << "Couldn't write " << options.traceFile.value() << std::endl;
+        }
+    } catch (std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
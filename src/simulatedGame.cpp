@@ -0,0 +1,105 @@
+#include "simulatedGame.hpp"
+
+#include <stdexcept>
+
+#include "display.hpp"
+
+GameResult playSimulatedGame(unsigned seed, const GameSettings& settings) {
+    if (settings.frameInterval <= VIRTUAL_PROCESSING_DELAY) {
+        throw std::invalid_argument("frame interval must be more than the processing delay");
+    }
+
+    GameSimulator game(seed);
+    VideoFeed display(game, true);
+    display.setViewport(game.viewport());
+
+    Driver driver{game, display};
+    driver.setClock([&game]() { return game.now(); });
+    driver.setPlannerEngine(settings.engine);
+    driver.setPlanningBudget(settings.budget);
+    driver.setSweptCollision(settings.sweptCollision);
+    driver.setSearchQuantum(settings.searchQuantum);
+    driver.setAdaptiveStep(settings.adaptiveStep);
+    driver.setWarmStart(settings.warmStart);
+    driver.setPolicyTable(settings.policy);
+
+    FeatureDetector detector{display};
+    detector.setMode(settings.detection);
+    detector.setGapTracking(settings.tracking);
+    detector.setBirdTracking(settings.tracking);
+
+    GameResult result;
+    using Steady = std::chrono::steady_clock;
+
+    bool engaged = false;
+    while (game.crash() == GameSimulator::Crash::NONE && game.now() - TimePoint{} < settings.timeLimit) {
+        const TimePoint frameTime = game.now();
+
+        const Steady::time_point frameStart = Steady::now();
+        std::optional<Position> birdPos;
+        std::pair<std::optional<Gap>, std::optional<Gap>> gaps;
+        if (settings.groundTruth) {
+            birdPos = game.birdPosition();
+            gaps = game.gapsAheadOfBird();
+        } else {
+            display.captureFrame();
+            detector.process(display.getCurrentFrame(), frameTime);
+            birdPos = detector.findBird();
+            if (birdPos) {
+                gaps = detector.findGapsAheadOf(birdPos.value());
+            }
+        }
+        const Steady::time_point detected = Steady::now();
+        result.detect.add(detected - frameStart);
+
+        if (birdPos && gaps.first && !engaged) {
+            // same as pressing 'a' live, this is also the tap that starts the game
+            driver.takeOver(birdPos.value());
+            engaged = true;
+        }
+
+        game.advance(VIRTUAL_PROCESSING_DELAY);
+        driver.drive(birdPos, gaps, frameTime, frameTime);
+        const Steady::time_point frameEnd = Steady::now();
+        if (birdPos && gaps.first) {
+            result.plan.add(frameEnd - detected);
+        }
+        result.frame.add(frameEnd - frameStart);
+
+        game.advance(settings.frameInterval - VIRTUAL_PROCESSING_DELAY);
+    }
+
+    result.score = game.score();
+    result.crash = game.crash();
+    result.taps = game.taps();
+    result.played = game.now() - TimePoint{};
+    result.search = driver.searchTotals();
+    return result;
+}
+
+void checkPolicy(const GameSettings& settings) {
+    if (!settings.policy) {
+        return;
+    }
+    settings.policy->checkSearchSettings(SIMULATED_ARM_TAP_DELAY, SIMULATED_ARM_LIFT_DELAY, settings.searchQuantum,
+                                         settings.sweptCollision, settings.adaptiveStep);
+
+    // the same geometry every game is played in
+    GameSimulator game;
+    VideoFeed display(game, true);
+    display.setViewport(game.viewport());
+    settings.policy->warnUnlessMatches(display.pixelYToPosition(display.getGroundLevel()),
+                                       display.pixelXToPosition(display.getRightBoundary()) - BIRD_X_COORDINATE);
+}
+
+const char* describe(GameSimulator::Crash crash) {
+    switch (crash) {
+        case GameSimulator::Crash::NONE:
+            return "none";
+        case GameSimulator::Crash::PIPE:
+            return "pipe";
+        case GameSimulator::Crash::GROUND:
+            return "ground";
+    }
+    return "?";
+}
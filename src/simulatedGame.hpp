@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+
+#include "constants.hpp"
+#include "driver.hpp"
+#include "featureDetector.hpp"
+#include "gameSimulator.hpp"
+#include "latencyStats.hpp"
+#include "policyTable.hpp"
+#include "units.hpp"
+
+/// How the pipeline plays a game against the GameSimulator.
+struct GameSettings {
+    Driver::PlannerEngine engine{Driver::PlannerEngine::RECURSIVE};
+    FeatureDetector::Mode detection{FeatureDetector::Mode::LAZY};
+    std::optional<std::chrono::microseconds> budget;
+    TimePoint::duration frameInterval{16}; // ~60Hz like the emulator, must be more than VIRTUAL_PROCESSING_DELAY
+    TimePoint::duration timeLimit{std::chrono::minutes{2}}; // of game time, the game is cut short if it gets this far
+    bool tracking{false}; // gap and bird tracking in the FeatureDetector
+    bool sweptCollision{false}; // see Driver::setSweptCollision()
+    TimePoint::duration searchQuantum{SIMULATION_TIME_QUANTUM}; // see Driver::setSearchQuantum()
+    bool adaptiveStep{false}; // see Driver::setAdaptiveStep()
+    bool warmStart{false}; // see Driver::setWarmStart()
+    std::shared_ptr<const PolicyTable> policy; // see Driver::setPolicyTable(), shared by all games
+    // the bird and the gaps straight from the simulator instead of detected in its frames, to measure the planner on
+    // its own (detection misses change which states it's asked about)
+    bool groundTruth{false};
+};
+
+struct GameResult {
+    int score;
+    GameSimulator::Crash crash; // NONE if the time limit was reached
+    int taps;
+    TimePoint::duration played;
+    Driver::SearchTotals search;
+
+    LatencyStats detect{"detect"}; // bird and gaps
+    LatencyStats plan{"plan"}; // drive(), on frames with something to plan for
+    LatencyStats frame{"frame"};
+};
+
+/**
+ * Plays a game closed loop and headless: frames are rendered by the simulator, detected and planned on as they would
+ * be live, and the taps change what's rendered next. Runs on the simulator's clock, as fast as the pipeline goes.
+ *
+ * Everything is created for (and owned by) the game, so games can be played on any number of threads at once.
+ */
+GameResult playSimulatedGame(unsigned seed, const GameSettings& settings);
+
+/// For the runners' options, before any game is played: throws std::invalid_argument if the policy table wasn't
+/// computed for the simulated arm and the search settings, warns once if not for the simulator's geometry.
+void checkPolicy(const GameSettings& settings);
+
+const char* describe(GameSimulator::Crash crash);
@@ -0,0 +1,190 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "constants.hpp"
+
+namespace sweep {
+
+float Piece::x(float t) const {
+    return x0 + HORIZONTAL_SPEED.val.val * t;
+}
+
+float Piece::y(float t) const {
+    return y0 + speed * t + acceleration / 2 * t * t;
+}
+
+Motion Path::fall(const Motion& motion, TimePoint::duration duration) {
+    assert(count < static_cast<int>(pieces.size()));
+    float x = motion.position.x.val;
+    float y = motion.position.y.val;
+    float speed = motion.verticalSpeed.val.val;
+    float remaining = static_cast<float>(duration.count());
+
+    if (speed < TERMINAL_VELOCITY.val.val) {
+        const float untilTerminal = (TERMINAL_VELOCITY.val.val - speed) / GRAVITY.speed.val.val;
+        const Piece accelerating{x, y, speed, GRAVITY.speed.val.val, std::min(remaining, untilTerminal)};
+        pieces[count++] = accelerating;
+
+        x = accelerating.x(accelerating.duration);
+        y = accelerating.y(accelerating.duration);
+        speed = std::min(speed + GRAVITY.speed.val.val * accelerating.duration, TERMINAL_VELOCITY.val.val);
+        remaining -= accelerating.duration;
+    }
+    if (remaining > 0) {
+        assert(count < static_cast<int>(pieces.size()));
+        const Piece terminal{x, y, TERMINAL_VELOCITY.val.val, 0, remaining};
+        pieces[count++] = terminal;
+
+        x = terminal.x(remaining);
+        y = terminal.y(remaining);
+    }
+
+    return {{Coordinate{x}, Coordinate{y}}, Speed{Distance{speed}}};
+}
+
+// lowest and highest y over [from, to]
+static std::pair<float, float> verticalRange(const Piece& piece, float from, float to) {
+    float top = std::min(piece.y(from), piece.y(to));
+    float bottom = std::max(piece.y(from), piece.y(to));
+    if (piece.acceleration != 0) {
+        // top of the arc, if the bird turns around in the meantime
+        const float apex = -piece.speed / piece.acceleration;
+        if (apex > from && apex < to) {
+            top = std::min(top, piece.y(apex));
+            bottom = std::max(bottom, piece.y(apex));
+        }
+    }
+    return {top, bottom};
+}
+
+std::pair<float, float> verticalRange(const Piece& piece) {
+    return verticalRange(piece, 0, piece.duration);
+}
+
+// value of c3 s^3 + c2 s^2 + c1 s + c0
+static double cubic(double c3, double c2, double c1, double c0, double s) {
+    return ((c3 * s + c2) * s + c1) * s + c0;
+}
+
+static constexpr int BISECTION_STEPS = 30;
+
+// Calls `root` with every s in (0, 1) where the cubic crosses zero. Splits the interval at the cubic's turning points
+// so that it's monotonic on each part, then bisects the parts where it changes sign.
+template<typename Root>
+static void cubicRoots(double c3, double c2, double c1, double c0, Root&& root) {
+    std::array<double, 4> bounds{0, 1, 1, 1};
+    int boundCount = 1;
+    // turning points are the roots of 3 c3 s^2 + 2 c2 s + c1
+    const double a = 3 * c3;
+    const double b = 2 * c2;
+    if (std::abs(a) > std::numeric_limits<double>::epsilon()) {
+        const double discriminant = b * b - 4 * a * c1;
+        if (discriminant > 0) {
+            const double sqrtDiscriminant = std::sqrt(discriminant);
+            double first = (-b - sqrtDiscriminant) / (2 * a);
+            double second = (-b + sqrtDiscriminant) / (2 * a);
+            if (first > second) {
+                std::swap(first, second);
+            }
+            for (double turningPoint : {first, second}) {
+                if (turningPoint > 0 && turningPoint < 1) {
+                    bounds[boundCount++] = turningPoint;
+                }
+            }
+        }
+    } else if (std::abs(b) > std::numeric_limits<double>::epsilon()) {
+        const double turningPoint = -c1 / b;
+        if (turningPoint > 0 && turningPoint < 1) {
+            bounds[boundCount++] = turningPoint;
+        }
+    }
+    bounds[boundCount++] = 1;
+
+    for (int i = 0; i + 1 < boundCount; ++i) {
+        double low = bounds[i];
+        double high = bounds[i + 1];
+        double lowValue = cubic(c3, c2, c1, c0, low);
+        if ((lowValue > 0) == (cubic(c3, c2, c1, c0, high) > 0)) {
+            continue;
+        }
+        for (int step = 0; step < BISECTION_STEPS; ++step) {
+            const double middle = (low + high) / 2;
+            const double middleValue = cubic(c3, c2, c1, c0, middle);
+            if ((middleValue > 0) == (lowValue > 0)) {
+                low = middle;
+                lowValue = middleValue;
+            } else {
+                high = middle;
+            }
+        }
+        root((low + high) / 2);
+    }
+}
+
+// closest the piece gets to the point (x, y) over [from, to]
+static float closestApproach(const Piece& piece, float from, float to, float x, float y) {
+    const auto distance = [&](float t) {
+        return std::hypot(piece.x(t) - x, piece.y(t) - y);
+    };
+    float closest = std::min(distance(from), distance(to));
+
+    // Rebased to `from` and scaled to s in [0, 1], half the derivative of the squared distance is the cubic
+    //     a^2/2 L^3 s^3 + 3/2 a v L^2 s^2 + (h^2 + v^2 + a dy) L s + h dx + v dy
+    // where v, dx and dy are the speed and the offsets from the point at `from`.
+    const double length = to - from;
+    const double h = HORIZONTAL_SPEED.val.val;
+    const double a = piece.acceleration;
+    const double v = piece.speed + a * from;
+    const double dx = piece.x(from) - x;
+    const double dy = piece.y(from) - y;
+    cubicRoots(a * a / 2 * length * length * length, 1.5 * a * v * length * length,
+               (h * h + v * v + a * dy) * length, h * dx + v * dy,
+               [&](double s) { closest = std::min(closest, distance(static_cast<float>(from + s * length))); });
+
+    return closest;
+}
+
+std::optional<Distance> pipeClearance(const Gap& gap, const Piece& piece) {
+    const float radius = BIRD_RADIUS.val;
+    const float left = gap.lowerLeft.x.val;
+    const float right = gap.lowerRight.x.val;
+    // when the bird's centre crosses the edges of the pipe, x only ever grows
+    const float reachesLeft = (left - piece.x0) / HORIZONTAL_SPEED.val.val;
+    const float reachesRight = (right - piece.x0) / HORIZONTAL_SPEED.val.val;
+
+    // same as Driver::pipeClearance(), the corners matter outside the pipe and the top and bottom of the gap within
+    float clearance = std::numeric_limits<float>::max();
+    if (reachesLeft > 0) {
+        const float to = std::min(piece.duration, reachesLeft);
+        clearance = std::min({clearance,
+                              closestApproach(piece, 0, to, left, gap.lowerLeft.y.val) - radius,
+                              closestApproach(piece, 0, to, left, gap.upperLeft.y.val) - radius});
+    }
+
+    const float within = std::max(0.f, reachesLeft);
+    const float withinTo = std::min(piece.duration, reachesRight);
+    if (within < withinTo) {
+        const std::pair<float, float> range = verticalRange(piece, within, withinTo);
+        clearance = std::min({clearance,
+                              range.first - radius - gap.upperLeft.y.val,
+                              gap.lowerLeft.y.val - (range.second + radius)});
+    }
+
+    if (reachesRight < piece.duration) {
+        const float from = std::max(0.f, reachesRight);
+        clearance = std::min({clearance,
+                              closestApproach(piece, from, piece.duration, right, gap.lowerRight.y.val) - radius,
+                              closestApproach(piece, from, piece.duration, right, gap.upperRight.y.val) - radius});
+    }
+
+    if (clearance < SAFETY_BUFFER.val) {
+        return {};
+    }
+    return Distance{clearance};
+}
+
+} // namespace sweep
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <utility>
+
+#include "gap.hpp"
+#include "units.hpp"
+
+/*
+ * Continuous collision checks over the bird's motion between two search nodes, rather than just at the nodes - so
+ * that a path can't cut through the corner of a pipe between time quanta, however long the quanta are.
+ */
+namespace sweep {
+
+/// A stretch of motion with constant vertical acceleration (gravity, or none at terminal velocity), t in [0, duration]:
+///     x(t) = x0 + HORIZONTAL_SPEED * t
+///     y(t) = y0 + speed * t + acceleration / 2 * t^2
+/// Times are in ms, same as the units.
+struct Piece {
+    float x0;
+    float y0;
+    float speed;
+    float acceleration;
+    float duration;
+
+    float x(float t) const;
+    float y(float t) const;
+};
+
+/// Motion split into pieces of constant acceleration. A quantum with a tap in it is at most four: falling until the
+/// tap and after it, each possibly reaching terminal velocity on the way.
+struct Path {
+    std::array<Piece, 4> pieces;
+    int count{0};
+
+    /// Falls freely for `duration` from `motion`, appended to the path. Returns the motion at the end.
+    Motion fall(const Motion& motion, TimePoint::duration duration);
+};
+
+/// Lowest and highest point of the bird's centre along the piece (y grows down, so `second` is the lowest point).
+std::pair<float, float> verticalRange(const Piece& piece);
+
+/// The smallest pipeClearance() (see Driver) anywhere along the piece, no value if the bird hits the pipe somewhere.
+std::optional<Distance> pipeClearance(const Gap& gap, const Piece& piece);
+
+} // namespace sweep
@@ -0,0 +1,112 @@
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_queues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    for (unsigned i = 1; i < threadCount; ++i) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> _(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> _(m_mutex);
+        assert(m_remaining == 0 && "parallelFor() isn't reentrant");
+        m_task = &task;
+        m_remaining = count;
+
+        // deal the tasks out round-robin, neighbouring tasks tend to be of similar size
+        for (size_t q = 0; q < m_queues.size(); ++q) {
+            std::unique_lock<std::mutex> queueLock(m_queues[q]->mutex);
+            m_queues[q]->tasks.clear();
+            m_queues[q]->head = 0;
+            for (size_t i = q; i < count; i += m_queues.size()) {
+                m_queues[q]->tasks.push_back(i);
+            }
+        }
+
+        ++m_generation;
+    }
+    m_workAvailable.notify_all();
+
+    while (runOne(0)) {}
+
+    // everything has been picked up, wait for whatever is still running on the workers
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allDone.wait(lock, [&]() { return m_remaining == 0; });
+    m_task = nullptr;
+}
+
+bool ThreadPool::runOne(unsigned queueIndex) {
+    std::optional<size_t> taskIndex;
+
+    {
+        TaskQueue& own = *m_queues[queueIndex];
+        std::unique_lock<std::mutex> _(own.mutex);
+        if (own.head < own.tasks.size()) {
+            taskIndex = own.tasks[own.head++];
+        }
+    }
+
+    // steal from the back of the others, starting with our neighbour so thieves don't all pile onto the same queue
+    for (size_t offset = 1; !taskIndex && offset < m_queues.size(); ++offset) {
+        TaskQueue& victim = *m_queues[(queueIndex + offset) % m_queues.size()];
+        std::unique_lock<std::mutex> _(victim.mutex);
+        if (victim.head < victim.tasks.size()) {
+            taskIndex = victim.tasks.back();
+            victim.tasks.pop_back();
+        }
+    }
+
+    if (!taskIndex) {
+        return false;
+    }
+
+    (*m_task)(taskIndex.value());
+
+    if (--m_remaining == 0) {
+        // lock so the notification can't slip in between the caller checking m_remaining and going to sleep
+        std::unique_lock<std::mutex> _(m_mutex);
+        m_allDone.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned queueIndex) {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [&]() { return m_stopping || m_generation != seenGeneration; });
+            if (m_stopping) {
+                return;
+            }
+            seenGeneration = m_generation;
+        }
+
+        while (runOne(queueIndex)) {}
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads, started once and kept for the lifetime of the pool, so fork-join work can be spread
+ * across cores without spawning threads per call. Each worker has its own task queue and, once it runs dry, steals from
+ * the back of the others'. The thread calling parallelFor() works as well rather than just waiting.
+ */
+class ThreadPool {
+public:
+    /// @param threadCount total number of threads working on a parallelFor(), including the caller
+    explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned threadCount() const {
+        return static_cast<unsigned>(m_queues.size());
+    }
+
+    /// Runs task(i) for every i in [0, count) and returns once all of them have finished. Not reentrant.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        // all pushes happen before any pops, so a vector with a moving head does (and keeps its capacity)
+        std::vector<size_t> tasks;
+        size_t head{0};
+    };
+
+    void workerLoop(unsigned queueIndex);
+    /// Runs one task from our own queue or, failing that, one stolen from another. False if there was nothing to run.
+    bool runOne(unsigned queueIndex);
+
+    // queue 0 belongs to the thread calling parallelFor()
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_allDone;
+    const std::function<void(size_t)>* m_task{nullptr};
+    std::atomic<size_t> m_remaining{0};
+    uint64_t m_generation{0};
+    bool m_stopping{false};
+};
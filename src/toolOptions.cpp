@@ -0,0 +1,32 @@
+#include "toolOptions.hpp"
+
+#include <stdexcept>
+
+std::string optionValue(int argc, char** argv, int& i) {
+    if (i + 1 >= argc) {
+        throw std::invalid_argument(std::string(argv[i]) + " needs a value");
+    }
+    return argv[++i];
+}
+
+Driver::PlannerEngine parsePlannerEngine(const std::string& name) {
+    if (name == "recursive") {
+        return Driver::PlannerEngine::RECURSIVE;
+    } else if (name == "batch") {
+        return Driver::PlannerEngine::BATCH;
+    } else if (name == "parallel") {
+        return Driver::PlannerEngine::PARALLEL;
+    }
+    throw std::invalid_argument("unknown engine: " + name);
+}
+
+FeatureDetector::Mode parseDetectionMode(const std::string& name) {
+    if (name == "full") {
+        return FeatureDetector::Mode::FULL;
+    } else if (name == "lazy") {
+        return FeatureDetector::Mode::LAZY;
+    } else if (name == "pyramid") {
+        return FeatureDetector::Mode::PYRAMID;
+    }
+    throw std::invalid_argument("unknown detection mode: " + name);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include "driver.hpp"
+#include "featureDetector.hpp"
+
+/*
+ * Command line parsing shared by the offline tools (replayBenchmark, simulateGame, batchGames, generatePolicy). They
+ * all report a bad option by throwing std::invalid_argument.
+ */
+
+/// The value of the option at argv[i], which is moved past it.
+std::string optionValue(int argc, char** argv, int& i);
+
+Driver::PlannerEngine parsePlannerEngine(const std::string& name);
+FeatureDetector::Mode parseDetectionMode(const std::string& name);
@@ -0,0 +1,163 @@
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tracer {
+
+namespace {
+
+/// Single writer (its thread), any number of readers. Fields are atomics so that a reader racing with the writer
+/// overwriting an event gets a torn event (which it then throws away) rather than undefined behaviour.
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+struct ThreadBuffer {
+    explicit ThreadBuffer(uint32_t threadId) : id{threadId}, events(EVENTS_PER_THREAD) {}
+
+    const uint32_t id;
+    std::atomic<const char*> name{nullptr};
+    std::vector<Event> events; // allocated up front, never resized
+    std::atomic<uint64_t> written{0}; // total ever, events[written % size] is the next to be overwritten
+};
+
+const std::chrono::steady_clock::time_point EPOCH = std::chrono::steady_clock::now();
+
+// buffers outlive their threads so their events can still be dumped
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::unique_lock<std::mutex> _(registryMutex);
+        registry.push_back(std::make_unique<ThreadBuffer>(static_cast<uint32_t>(registry.size() + 1)));
+        buffer = registry.back().get();
+    }
+    return *buffer;
+}
+
+} // namespace
+
+namespace detail {
+
+std::atomic<bool> enabled{false};
+
+uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - EPOCH).count();
+}
+
+void record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = threadBuffer();
+    const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index % buffer.events.size()];
+    // pairs with the fence in writeChromeTrace(): whoever sees any of this event also sees `written` up to index
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+void setEnabled(bool enabled) {
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void setThreadName(const char* name) {
+    threadBuffer().name.store(name, std::memory_order_relaxed);
+}
+
+static void writeString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+void writeChromeTrace(std::ostream& out) {
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::unique_lock<std::mutex> _(registryMutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+            buffers.push_back(buffer.get());
+        }
+    }
+
+    struct Copy {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+    std::vector<Copy> copies;
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    const auto separator = [&]() {
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+    };
+
+    for (ThreadBuffer* buffer : buffers) {
+        const size_t capacity = buffer->events.size();
+        const uint64_t writtenBefore = buffer->written.load(std::memory_order_acquire);
+        const uint64_t oldest = writtenBefore > capacity ? writtenBefore - capacity : 0;
+
+        copies.clear();
+        for (uint64_t i = oldest; i < writtenBefore; ++i) {
+            const Event& event = buffer->events[i % capacity];
+            copies.push_back({event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+                              event.end.load(std::memory_order_relaxed)});
+        }
+
+        // anything the thread may have lapped while we were copying is unreliable, including the slot it may be
+        // part-way through overwriting (event number writtenAfter, which shares a slot with writtenAfter - capacity).
+        // The fence keeps the copies above from being read after `written`, which would make them look older.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t writtenAfter = buffer->written.load(std::memory_order_acquire);
+        const uint64_t firstReliable = writtenAfter >= capacity ? writtenAfter - capacity + 1 : 0;
+
+        const char* threadName = buffer->name.load(std::memory_order_relaxed);
+        if (threadName) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+            writeString(out, threadName);
+            out << "}}";
+        }
+
+        for (uint64_t i = std::max(oldest, firstReliable); i < writtenBefore; ++i) {
+            const Copy& event = copies[i - oldest];
+            separator();
+            out << "{\"name\":";
+            writeString(out, event.name);
+            // microseconds, keeping the nanoseconds as decimals
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":" << event.start / 1000 << "."
+                << event.start % 1000 / 100 << event.start % 100 / 10 << event.start % 10
+                << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+        }
+    }
+
+    out << "]}\n";
+}
+
+bool dump(const std::string& path) {
+    std::ofstream file(path);
+    writeChromeTrace(file);
+    return static_cast<bool>(file);
+}
+
+} // namespace tracer
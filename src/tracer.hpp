@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+ * Scoped timing spans, recorded into a per-thread ring buffer and exported as Chrome trace JSON (chrome://tracing or
+ * ui.perfetto.dev) on demand. Disabled by default - a disabled span is a relaxed load and a branch, nothing else.
+ *
+ *     void Foo::bar() {
+ *         TRACE_SPAN("bar");
+ *         ...
+ *     }
+ *
+ * Span names must be string literals (or otherwise outlive the tracer), only the pointer is stored.
+ */
+namespace tracer {
+
+/// Events kept per thread, older ones are overwritten.
+constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+namespace detail {
+extern std::atomic<bool> enabled;
+
+uint64_t now(); // ns since the tracer's epoch
+void record(const char* name, uint64_t start, uint64_t end);
+} // namespace detail
+
+inline bool enabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool enabled);
+
+/// Labels the calling thread's track in the trace.
+void setThreadName(const char* name);
+
+/// Writes everything still in the ring buffers (of all threads, including ones that have exited) as Chrome trace JSON.
+/// Can be called while other threads are tracing, events they overwrite in the meantime are left out.
+void writeChromeTrace(std::ostream& out);
+
+/// writeChromeTrace() into a file, false if it couldn't be written.
+bool dump(const std::string& path);
+
+class Span {
+public:
+    explicit Span(const char* name) : m_name{name}, m_start{enabled() ? detail::now() : NOT_RECORDING} {}
+
+    ~Span() {
+        if (m_start != NOT_RECORDING) {
+            detail::record(m_name, m_start, detail::now());
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    static constexpr uint64_t NOT_RECORDING = UINT64_MAX;
+
+    const char* const m_name;
+    const uint64_t m_start;
+};
+
+} // namespace tracer
+
+#define TRACE_SPAN_CONCAT_IMPL(a, b) a##b
+#define TRACE_SPAN_CONCAT(a, b) TRACE_SPAN_CONCAT_IMPL(a, b)
+#define TRACE_SPAN(name) tracer::Span TRACE_SPAN_CONCAT(traceSpan, __LINE__){name}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+
+#include "constants.hpp"
+#include "units.hpp"
+
+/*
+ * Once the bird has been tapped, its vertical speed is a function of the time since that tap only. During search taps
+ * only happen at the start of a time quantum so, for a given arm, the bird is always at one of a handful of points of
+ * the same trajectory at the start of a quantum. These are tabulated here at compile time, so that stepping a search
+ * node is a lookup and an add rather than a full Driver::predictMotion().
+ */
+
+namespace trajectory {
+
+/// Vertical displacement over `deltaT` and the speed at the end of it. Same maths as Driver::predictMotion() (including
+/// rounding the terminal velocity period to whole milliseconds) but on plain floats, so it can run at compile time.
+struct VerticalStep {
+    float displacement;
+    float speed;
+};
+
+constexpr VerticalStep verticalStep(float startingSpeed, long deltaT) {
+    const float gravity = GRAVITY.speed.val.val;
+    const float terminalVelocity = TERMINAL_VELOCITY.val.val;
+    const float projectedSpeed = startingSpeed + gravity * deltaT;
+
+    if (projectedSpeed > terminalVelocity) {
+        const long tvPeriod = static_cast<int>((projectedSpeed - terminalVelocity) / gravity);
+        const float averageSpeedUnderAcceleration = (startingSpeed + (startingSpeed + gravity * (deltaT - tvPeriod))) / 2;
+        const float averageSpeed = averageSpeedUnderAcceleration * (static_cast<float>(deltaT - tvPeriod) / deltaT)
+                                   + terminalVelocity * (static_cast<float>(tvPeriod) / deltaT);
+        return {averageSpeed * deltaT, terminalVelocity};
+    } else {
+        return {(startingSpeed + projectedSpeed) / 2 * deltaT, projectedSpeed};
+    }
+}
+
+/// Upper bound on the number of quanta it takes to fall from JUMP_SPEED to TERMINAL_VELOCITY (plus one for the entry
+/// at terminal velocity) - beyond that, every quantum looks the same.
+constexpr size_t quantaToTerminalVelocity() {
+    float speed = JUMP_SPEED.val.val;
+    size_t quanta = 1;
+    while (speed < TERMINAL_VELOCITY.val.val) {
+        speed = verticalStep(speed, SIMULATION_TIME_QUANTUM.count()).speed;
+        ++quanta;
+    }
+    return quanta;
+}
+
+static constexpr size_t TABLE_SIZE = quantaToTerminalVelocity() + 1;
+
+static constexpr Distance QUANTUM_HORIZONTAL_DISPLACEMENT{HORIZONTAL_SPEED.val.val * SIMULATION_TIME_QUANTUM.count()};
+
+/// Vertical motion at SIMULATION_TIME_QUANTUM boundaries after a tap, indexed by the number of whole quanta since the
+/// quantum in which the tap happened (i.e. index 0 is SIMULATION_TIME_QUANTUM - tapDelay after the tap).
+struct Table {
+    std::array<float, TABLE_SIZE> speed{};
+    // displacement over the next quantum if we don't tap, ends up at index + 1
+    std::array<float, TABLE_SIZE> noTapDisplacement{};
+    // displacement over the next quantum if we tap at its start (so after the arm's tap delay), ends up at index 0
+    std::array<float, TABLE_SIZE> tapDisplacement{};
+
+    static constexpr int next(int quantaSinceTap) {
+        return quantaSinceTap + 1 < static_cast<int>(TABLE_SIZE) ? quantaSinceTap + 1 : quantaSinceTap;
+    }
+
+    Motion afterNoTap(const Motion& motion, int quantaSinceTap) const {
+        return {{motion.position.x + QUANTUM_HORIZONTAL_DISPLACEMENT,
+                 motion.position.y + Distance{noTapDisplacement[quantaSinceTap]}},
+                Speed{Distance{speed[next(quantaSinceTap)]}}};
+    }
+
+    Motion afterTap(const Motion& motion, int quantaSinceTap) const {
+        return {{motion.position.x + QUANTUM_HORIZONTAL_DISPLACEMENT,
+                 motion.position.y + Distance{tapDisplacement[quantaSinceTap]}},
+                Speed{Distance{speed[0]}}};
+    }
+};
+
+constexpr Table makeTable(std::chrono::milliseconds tapDelay) {
+    const long quantum = SIMULATION_TIME_QUANTUM.count();
+    const VerticalStep afterJump = verticalStep(JUMP_SPEED.val.val, quantum - tapDelay.count());
+
+    Table table;
+    float speed = afterJump.speed;
+    for (size_t i = 0; i < TABLE_SIZE; ++i) {
+        table.speed[i] = speed;
+
+        const VerticalStep noTap = verticalStep(speed, quantum);
+        table.noTapDisplacement[i] = noTap.displacement;
+        table.tapDisplacement[i] = verticalStep(speed, tapDelay.count()).displacement + afterJump.displacement;
+
+        speed = noTap.speed;
+    }
+
+    return table;
+}
+
+static_assert(SIMULATION_TIME_QUANTUM > PHYSICAL_ARM_TAP_DELAY && SIMULATION_TIME_QUANTUM > SIMULATED_ARM_TAP_DELAY,
+              "taps must land within the quantum they're issued in");
+
+inline constexpr Table PHYSICAL_ARM = makeTable(PHYSICAL_ARM_TAP_DELAY);
+inline constexpr Table SIMULATED_ARM = makeTable(SIMULATED_ARM_TAP_DELAY);
+
+/// @returns the table for an arm with the given tap delay or nullptr if it's not one we know at compile time
+constexpr const Table* forTapDelay(std::chrono::milliseconds tapDelay) {
+    if (tapDelay == PHYSICAL_ARM_TAP_DELAY) {
+        return &PHYSICAL_ARM;
+    } else if (tapDelay == SIMULATED_ARM_TAP_DELAY) {
+        return &SIMULATED_ARM;
+    }
+    return nullptr;
+}
+
+} // namespace trajectory
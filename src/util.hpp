@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <opencv2/core/types.hpp>
 
@@ -28,6 +30,13 @@ inline TimePoint toTime(std::chrono::system_clock::time_point&& point) {
     return std::chrono::time_point_cast<TimePoint::duration>(point);
 }
 
+/// Source of the current time, so that it can be replaced with a virtual one (e.g. when replaying a recording).
+using Clock = std::function<TimePoint()>;
+
+inline TimePoint systemNow() {
+    return toTime(std::chrono::system_clock::now());
+}
+
 class RAIICloser {
 public:
     RAIICloser(std::function<void()> closer) : m_closer(closer) {}